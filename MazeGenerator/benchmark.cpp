@@ -0,0 +1,194 @@
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include "../Project/modules/MazeBatchGenerator.hpp"
+#define BENCHMARK_MAZES 2000
+
+// Throughput of the batch maze generation (mazes/s) with an increasing number of threads,
+// latency and retries of a single maze generation for each generation mode,
+// then the carving test (per cell comparisons against wall bitmap) on big grids
+// Usage: ./bench [mazes number] [maze size]
+
+bool sameMaze(const Maze &a, const Maze &b)
+{
+  MazeView viewA = a.getMazeView();
+  MazeView viewB = b.getMazeView();
+  for (int r = 0; r < viewA.getHeight(); r++)
+    for (int c = 0; c < viewA.getWidth(); c++)
+      if (viewA.get(r, c) != viewB.get(r, c))
+        return false;
+  return viewA.getEndPoint().r == viewB.getEndPoint().r && viewA.getEndPoint().c == viewB.getEndPoint().c;
+}
+
+int perCellCarvableDirections(const MazeGrid &grid, int r, int c)
+{
+  // The carving test done with a comparison for each cell (as the mining did before the wall bitmap)
+  int directions = 0;
+  if (grid.get(r + 1, c) == MazeWay::WALL && grid.get(r + 1, c + 1) == MazeWay::WALL && grid.get(r + 1, c - 1) == MazeWay::WALL &&
+      r + 2 < grid.getHeight() - 1 && grid.get(r + 2, c) == MazeWay::WALL && grid.get(r + 2, c + 1) == MazeWay::WALL && grid.get(r + 2, c - 1) == MazeWay::WALL)
+    directions |= DOWN;
+  if (grid.get(r, c + 1) == MazeWay::WALL && grid.get(r + 1, c + 1) == MazeWay::WALL && grid.get(r - 1, c + 1) == MazeWay::WALL &&
+      c + 2 < grid.getWidth() - 1 && grid.get(r, c + 2) == MazeWay::WALL && grid.get(r + 1, c + 2) == MazeWay::WALL && grid.get(r - 1, c + 2) == MazeWay::WALL)
+    directions |= RIGHT;
+  if (grid.get(r, c - 1) == MazeWay::WALL && grid.get(r + 1, c - 1) == MazeWay::WALL && grid.get(r - 1, c - 1) == MazeWay::WALL &&
+      grid.get(r, c - 2) == MazeWay::WALL && grid.get(r + 1, c - 2) == MazeWay::WALL && grid.get(r - 1, c - 2) == MazeWay::WALL)
+    directions |= LEFT;
+  if (grid.get(r - 1, c) == MazeWay::WALL && grid.get(r - 1, c + 1) == MazeWay::WALL && grid.get(r - 1, c - 1) == MazeWay::WALL &&
+      grid.get(r - 2, c) == MazeWay::WALL && grid.get(r - 2, c + 1) == MazeWay::WALL && grid.get(r - 2, c - 1) == MazeWay::WALL)
+    directions |= UP;
+  return directions;
+}
+
+void carvingBenchmark(int size)
+{
+  // Test the four directions of every mineable cell of a grid with 10% of random path cells
+  MazeGrid grid(size, size);
+  MazeRandom random(size);
+  for (int r = 0; r < size; r++)
+    for (int c = 0; c < size; c++)
+      if (random.nextInt(10) == 0)
+        grid.set(r, c, MazeWay::PATH);
+
+  long long perCellSum = 0, bitmapSum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 1; r < size - 2; r++)
+    for (int c = 1; c < size - 2; c++)
+      perCellSum += perCellCarvableDirections(grid, r, c);
+  double perCellSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  start = std::chrono::steady_clock::now();
+  for (int r = 1; r < size - 2; r++)
+    for (int c = 1; c < size - 2; c++)
+      bitmapSum += grid.getCarvableDirections(r, c);
+  double bitmapSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  double cells = (double)(size - 3) * (size - 3);
+  std::cout << size << "x" << size << "\t" << perCellSeconds * 1e9 / cells << "\t" << bitmapSeconds * 1e9 / cells << "\t"
+            << perCellSeconds / bitmapSeconds << (perCellSum == bitmapSum ? "" : "\tMISMATCH") << std::endl;
+}
+
+bool parseInt(const char *text, int &value)
+{
+  // The whole text must be a number in the int range
+  char *end;
+  errno = 0;
+  long parsed = strtol(text, &end, 10);
+  if (end == text || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX)
+    return false;
+  value = (int)parsed;
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  int mazesNumber = BENCHMARK_MAZES;
+  int mazeSize = MAZE_SIZE;
+  if ((argc > 1 && !parseInt(argv[1], mazesNumber)) || (argc > 2 && !parseInt(argv[2], mazeSize)) ||
+      mazesNumber <= 0 || mazeSize < MIN_MAZE_SIZE)
+  {
+    std::cerr << "Usage: bench [mazes number > 0] [maze size >= " << MIN_MAZE_SIZE << "]" << std::endl;
+    return 1;
+  }
+  unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+
+  std::vector<uint64_t> seeds;
+  for (int i = 0; i < mazesNumber; i++)
+    seeds.push_back(i);
+  MazeBatchParameters parameters;
+  parameters.width = mazeSize;
+  parameters.height = mazeSize;
+
+  std::cout << mazesNumber << " mazes " << mazeSize << "x" << mazeSize << ", " << cores << " cores" << std::endl;
+  std::cout << "threads\tseconds\tmazes/s\tspeedup" << std::endl;
+  std::vector<Maze> reference;
+  double singleThreadRate = 0;
+  for (unsigned int threads = 1;; threads = std::min(threads * 2, cores))
+  {
+    ThreadPool pool(threads);
+    MazeBatchGenerator generator(pool);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Maze> mazes;
+    try
+    {
+      mazes = generator.generate(seeds, parameters);
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rate = mazesNumber / seconds;
+    if (threads == 1)
+    {
+      singleThreadRate = rate;
+      reference = std::move(mazes);
+    }
+    else
+    {
+      // More threads must not change the mazes
+      for (int i = 0; i < mazesNumber; i++)
+        if (!sameMaze(mazes[i], reference[i]))
+        {
+          std::cout << "Maze with seed " << seeds[i] << " differs with " << threads << " threads" << std::endl;
+          return 1;
+        }
+    }
+    std::cout << threads << "\t" << seconds << "\t" << rate << "\t" << rate / singleThreadRate << std::endl;
+    if (threads == cores)
+      break;
+  }
+
+  std::cout << std::endl
+            << "mode\tp50 ms\tp99 ms\tmax ms\titerations\tpath retries\tlights retries\textensions" << std::endl;
+  const char *modeNames[] = {"rejection", "constrained"};
+  for (GenerationMode mode : {GenerationMode::REJECTION, GenerationMode::CONSTRAINED})
+  {
+    std::vector<double> times;
+    MazeGenerationStats total;
+    std::string error;
+    for (uint64_t seed : seeds)
+    {
+      Maze maze(seed, mazeSize, mazeSize);
+      maze.setVerbose(false);
+      maze.setGenerationMode(mode);
+      auto start = std::chrono::steady_clock::now();
+      try
+      {
+        maze.generateMaze();
+      }
+      catch (const std::exception &e)
+      {
+        // The rejection mode gives up on big mazes: the other mode is still measured
+        error = e.what();
+        break;
+      }
+      times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+      total.iterations += maze.getGenerationStats().iterations;
+      total.pathRetries += maze.getGenerationStats().pathRetries;
+      total.lightsRetries += maze.getGenerationStats().lightsRetries;
+      total.extensions += maze.getGenerationStats().extensions;
+    }
+    if (!error.empty())
+    {
+      std::cout << modeNames[mode] << "\t" << error << std::endl;
+      continue;
+    }
+    std::sort(times.begin(), times.end());
+    std::cout << modeNames[mode] << "\t" << times[times.size() / 2] << "\t" << times[times.size() * 99 / 100] << "\t" << times.back() << "\t"
+              << (double)total.iterations / mazesNumber << "\t" << total.pathRetries << "\t" << total.lightsRetries << "\t" << total.extensions << std::endl;
+  }
+
+#ifdef __AVX2__
+  std::cout << std::endl
+            << "carving test (AVX2)" << std::endl;
+#else
+  std::cout << std::endl
+            << "carving test" << std::endl;
+#endif
+  std::cout << "grid\tper cell ns\tbitmap ns\tspeedup" << std::endl;
+  for (int size : {64, 512, 4096})
+    carvingBenchmark(size);
+  return 0;
+}
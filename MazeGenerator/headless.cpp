@@ -0,0 +1,249 @@
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "../Project/modules/MazeBatchGenerator.hpp"
+#ifdef _WIN32
+#define NOMINMAX // std::min and std::max, not the macros of windows.h
+#include <windows.h> // Before psapi.h, which needs its types
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#define HEADLESS_CHUNK_SIZE 4096 // Mazes generated (and kept in memory) at once
+
+// Generate mazes without a window, write them to a file and report the throughput
+// Usage: ./headless [options]
+//   --from S          first seed (default 0)
+//   --count N         number of mazes (at least 1), seeds from S to S + N - 1 (default 1000)
+//   --size W[xH]      maze size, at least MIN_MAZE_SIZE (default MAZE_SIZE)
+//   --threads T       generation threads, at least 1 (default: all the cores)
+//   --mode M          rejection or constrained (default rejection, constrained is needed beyond about 100x100)
+//   --format F        binary (maze library, see Maze::writeMaze), text or none (default binary)
+//   --output PATH     output file (default mazes.bin, or stdout for the text format)
+
+void printUsage()
+{
+  std::cerr << "Usage: headless [--from S] [--count N] [--size W[xH]] [--threads T] [--mode rejection|constrained]"
+            << " [--format binary|text|none] [--output PATH]" << std::endl
+            << "N and T at least 1, W and H at least " << MIN_MAZE_SIZE << std::endl;
+}
+
+bool parseNumber(const char *text, long long minimum, long long maximum, long long &value, const char **end = nullptr)
+{
+  // A number between minimum and maximum, then the end of the text (or, with end, whatever follows)
+  char *numberEnd;
+  errno = 0;
+  long long parsed = strtoll(text, &numberEnd, 10);
+  if (numberEnd == text || (!end && *numberEnd != '\0') || errno == ERANGE || parsed < minimum || parsed > maximum)
+    return false;
+  if (end)
+    *end = numberEnd;
+  value = parsed;
+  return true;
+}
+
+bool parseSeed(const char *text, uint64_t &value)
+{
+  // strtoull accepts a sign (and negates the number): the seed must start with a digit
+  char *end;
+  errno = 0;
+  unsigned long long parsed = strtoull(text, &end, 10);
+  if (!isdigit((unsigned char)text[0]) || *end != '\0' || errno == ERANGE)
+    return false;
+  value = parsed;
+  return true;
+}
+
+bool parseSize(const char *text, MazeBatchParameters &parameters)
+{
+  // W or WxH
+  long long width, height;
+  const char *end;
+  if (!parseNumber(text, MIN_MAZE_SIZE, INT_MAX, width, &end))
+    return false;
+  if (*end == '\0')
+    height = width;
+  else if (*end != 'x' || !parseNumber(end + 1, MIN_MAZE_SIZE, INT_MAX, height))
+    return false;
+  parameters.width = (int)width;
+  parameters.height = (int)height;
+  return true;
+}
+
+double peakMemoryMB()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+  return 0;
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+  return usage.ru_maxrss / 1024.0; // KB
+#endif
+#endif
+}
+
+void writeTextMaze(std::ostream &out, const Maze &maze)
+{
+  // # wall, . path, S start, E end, K key, L path cell with a wall light (start and end are always shown)
+  MazeView view = maze.getMazeView();
+  std::vector<std::string> rows(view.getHeight(), std::string(view.getWidth(), '#'));
+  for (int r = 0; r < view.getHeight(); r++)
+    for (int c = 0; c < view.getWidth(); c++)
+      switch (view.get(r, c))
+      {
+      case PATH:
+        rows[r][c] = '.';
+        break;
+      case START:
+        rows[r][c] = 'S';
+        break;
+      case END:
+        rows[r][c] = 'E';
+        break;
+      default:
+        break;
+      }
+  for (const Light &light : view.getLights())
+    if (rows[light.point.r][light.point.c] == '.')
+      rows[light.point.r][light.point.c] = 'L';
+  for (const Key &key : view.getKeys())
+    rows[key.point.r][key.point.c] = 'K';
+  out << "seed " << maze.getSeed() << " " << view.getWidth() << "x" << view.getHeight() << "\n";
+  for (const std::string &row : rows)
+    out << row << "\n";
+  out << "\n";
+}
+
+int main(int argc, char **argv)
+{
+  uint64_t firstSeed = 0;
+  long long mazesNumber = 1000;
+  MazeBatchParameters parameters;
+  unsigned int threads = std::thread::hardware_concurrency();
+  std::string format = "binary";
+  std::string outputPath;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string option = argv[i];
+    if (i + 1 >= argc)
+    {
+      printUsage();
+      return 1;
+    }
+    std::string value = argv[++i];
+    bool valid = true;
+    long long number = 0;
+    if (option == "--from")
+      valid = parseSeed(value.c_str(), firstSeed);
+    else if (option == "--count")
+      valid = parseNumber(value.c_str(), 1, LLONG_MAX, mazesNumber);
+    else if (option == "--size")
+      valid = parseSize(value.c_str(), parameters);
+    else if (option == "--threads")
+    {
+      valid = parseNumber(value.c_str(), 1, INT_MAX, number);
+      threads = (unsigned int)number;
+    }
+    else if (option == "--mode" && (value == "rejection" || value == "constrained"))
+      parameters.mode = value == "rejection" ? GenerationMode::REJECTION : GenerationMode::CONSTRAINED;
+    else if (option == "--format" && (value == "binary" || value == "text" || value == "none"))
+      format = value;
+    else if (option == "--output")
+      outputPath = value;
+    else
+      valid = false;
+    if (!valid)
+    {
+      std::cerr << "Invalid " << option << " " << value << std::endl;
+      printUsage();
+      return 1;
+    }
+  }
+  if (outputPath.empty() && format == "binary")
+    outputPath = "mazes.bin";
+
+  std::ofstream outputFile;
+  std::ostream *output = &std::cout;
+  if (format != "none" && !outputPath.empty())
+  {
+    outputFile.open(outputPath, std::ios::binary | std::ios::trunc);
+    if (!outputFile)
+    {
+      std::cerr << "Can't open " << outputPath << std::endl;
+      return 1;
+    }
+    output = &outputFile;
+  }
+  // The report goes to stderr when the mazes are written to stdout
+  std::ostream &report = output == &std::cout && format != "none" ? std::cerr : std::cout;
+
+  ThreadPool pool(threads);
+  MazeBatchGenerator generator(pool);
+  MazeGenerationStats total;
+  double generationSeconds = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<uint8_t> buffer;
+  for (long long first = 0; first < mazesNumber; first += HEADLESS_CHUNK_SIZE)
+  {
+    std::vector<uint64_t> seeds;
+    for (long long i = first; i < std::min(first + HEADLESS_CHUNK_SIZE, mazesNumber); i++)
+      seeds.push_back(firstSeed + i);
+    auto generationStart = std::chrono::steady_clock::now();
+    std::vector<Maze> mazes;
+    try
+    {
+      mazes = generator.generate(seeds, parameters);
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    generationSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - generationStart).count();
+
+    buffer.clear();
+    for (const Maze &maze : mazes)
+    {
+      total.iterations += maze.getGenerationStats().iterations;
+      total.pathRetries += maze.getGenerationStats().pathRetries;
+      total.lightsRetries += maze.getGenerationStats().lightsRetries;
+      total.extensions += maze.getGenerationStats().extensions;
+      if (format == "binary")
+        maze.writeMaze(buffer);
+      else if (format == "text")
+        writeTextMaze(*output, maze);
+    }
+    if (!buffer.empty())
+      output->write((const char *)buffer.data(), buffer.size());
+  }
+  output->flush();
+  if (!*output)
+  {
+    std::cerr << "Failed to write the mazes" << std::endl;
+    return 1;
+  }
+  double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  double cells = (double)mazesNumber * parameters.width * parameters.height;
+  report << mazesNumber << " mazes " << parameters.width << "x" << parameters.height << " (seeds " << firstSeed << " - " << firstSeed + mazesNumber - 1
+         << ", " << (parameters.mode == GenerationMode::REJECTION ? "rejection" : "constrained") << " mode) on " << pool.getThreadsNumber() << " threads" << std::endl;
+  report << "generation: " << generationSeconds << " s, " << mazesNumber / generationSeconds << " mazes/s, " << cells / generationSeconds << " cells/s" << std::endl;
+  report << "total (with output): " << totalSeconds << " s, " << mazesNumber / totalSeconds << " mazes/s" << std::endl;
+  report << "iterations: " << total.iterations << " (" << (double)total.iterations / mazesNumber << " per maze), path retries: " << total.pathRetries
+         << ", lights retries: " << total.lightsRetries << ", extensions: " << total.extensions << std::endl;
+  report << "peak RSS: " << peakMemoryMB() << " MB" << std::endl;
+  if (format != "none" && !outputPath.empty())
+    report << "written to " << outputPath << std::endl;
+  return 0;
+}
@@ -0,0 +1,293 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#define BLOCK_COMPRESSOR_REFINE_STEPS 3 // Least squares refits of the endpoints after the first guess
+
+class BlockCompressor
+{
+  /**
+   * Encoders of 4x4 RGBA8 blocks (64 bytes, rows from the top) to the BC1 and BC7 GPU formats.
+   * Both start from the endpoints at the extremes of the block along its principal axis, give each texel
+   * the nearest color of the palette, then refit the endpoints to the texels by least squares, keeping the
+   * endpoints with the lowest squared error.
+   * BC1 (8 bytes, RGB 565 endpoints, 4 colors) ignores the alpha. BC7 is always encoded in mode 6
+   * (16 bytes, a single RGBA subset with 7 bit endpoints and a shared low bit, 16 colors): the best of
+   * the eight modes for smooth blocks, and never much worse than the others on these textures.
+   */
+public:
+  static void loadBlock(const uint8_t *rgba, int width, int height, int blockX, int blockY, uint8_t block[64])
+  {
+    // The texels out of the image (when its size is not a multiple of 4) repeat the border
+    for (int y = 0; y < 4; y++)
+      for (int x = 0; x < 4; x++)
+      {
+        int sx = std::min(4 * blockX + x, width - 1), sy = std::min(4 * blockY + y, height - 1);
+        memcpy(block + 4 * (4 * y + x), rgba + 4 * ((size_t)sy * width + sx), 4);
+      }
+  }
+
+  static void encodeBC1(const uint8_t block[64], uint8_t out[8])
+  {
+    float lo[4], hi[4];
+    principalExtremes(block, 3, lo, hi);
+
+    uint16_t bestColors[2] = {0, 0};
+    uint8_t bestIndices[16] = {};
+    float bestError = INFINITY;
+    for (int step = 0; step <= BLOCK_COMPRESSOR_REFINE_STEPS; step++)
+    {
+      uint16_t colors[2] = {pack565(hi), pack565(lo)};
+      float palette[4][4];
+      bc1Palette(colors, palette);
+      uint8_t indices[16];
+      float error = assignIndices(block, 3, palette, 4, indices);
+      if (error < bestError)
+      {
+        bestError = error;
+        memcpy(bestColors, colors, sizeof(colors));
+        memcpy(bestIndices, indices, sizeof(indices));
+      }
+      if (error == 0 || !refit(block, 3, indices, BC1_WEIGHTS, hi, lo))
+        break;
+    }
+
+    // Four colors are decoded only when the first endpoint is the greater
+    if (bestColors[0] < bestColors[1])
+    {
+      std::swap(bestColors[0], bestColors[1]);
+      for (uint8_t &index : bestIndices)
+        index ^= 1; // 0 <-> 1, 2 <-> 3
+    }
+    else if (bestColors[0] == bestColors[1])
+      memset(bestIndices, 0, sizeof(bestIndices));
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++)
+      bits |= (uint32_t)bestIndices[i] << (2 * i);
+    out[0] = bestColors[0] & 0xFF;
+    out[1] = bestColors[0] >> 8;
+    out[2] = bestColors[1] & 0xFF;
+    out[3] = bestColors[1] >> 8;
+    for (int i = 0; i < 4; i++)
+      out[4 + i] = (uint8_t)(bits >> (8 * i));
+  }
+
+  static void encodeBC7(const uint8_t block[64], uint8_t out[16])
+  {
+    float lo[4], hi[4];
+    principalExtremes(block, 4, lo, hi);
+
+    uint8_t bestEndpoints[2][4] = {}, bestP[2] = {};
+    uint8_t bestIndices[16] = {};
+    float bestError = INFINITY;
+    for (int step = 0; step <= BLOCK_COMPRESSOR_REFINE_STEPS; step++)
+    {
+      uint8_t endpoints[2][4], p[2];
+      quantizeMode6(lo, endpoints[0], p[0]);
+      quantizeMode6(hi, endpoints[1], p[1]);
+      float palette[16][4];
+      for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+        {
+          int e0 = endpoints[0][c] << 1 | p[0], e1 = endpoints[1][c] << 1 | p[1];
+          palette[i][c] = (float)(((64 - BC7_WEIGHTS[i]) * e0 + BC7_WEIGHTS[i] * e1 + 32) >> 6);
+        }
+      uint8_t indices[16];
+      float error = assignIndices(block, 4, palette, 16, indices);
+      if (error < bestError)
+      {
+        bestError = error;
+        memcpy(bestEndpoints, endpoints, sizeof(endpoints));
+        memcpy(bestP, p, sizeof(p));
+        memcpy(bestIndices, indices, sizeof(indices));
+      }
+      if (error == 0 || !refit(block, 4, indices, BC7_WEIGHTS_UNIT, lo, hi))
+        break;
+    }
+
+    // The most significant bit of the first index is implicitly 0
+    if (bestIndices[0] >= 8)
+    {
+      std::swap(bestEndpoints[0], bestEndpoints[1]);
+      std::swap(bestP[0], bestP[1]);
+      for (uint8_t &index : bestIndices)
+        index = 15 - index;
+    }
+    memset(out, 0, 16);
+    int bit = 0;
+    putBits(out, bit, 1 << 6, 7); // Mode 6
+    for (int c = 0; c < 4; c++)
+      for (int e = 0; e < 2; e++)
+        putBits(out, bit, bestEndpoints[e][c], 7);
+    putBits(out, bit, bestP[0], 1);
+    putBits(out, bit, bestP[1], 1);
+    putBits(out, bit, bestIndices[0], 3);
+    for (int i = 1; i < 16; i++)
+      putBits(out, bit, bestIndices[i], 4);
+  }
+
+private:
+  static constexpr float BC1_WEIGHTS[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f}; // Of the second endpoint
+  static constexpr int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+  static constexpr float BC7_WEIGHTS_UNIT[16] = {0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f,
+                                                 26 / 64.0f, 30 / 64.0f, 34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f,
+                                                 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f};
+
+  static void principalExtremes(const uint8_t block[64], int channels, float lo[4], float hi[4])
+  {
+    // Principal axis of the texels by power iteration on their covariance
+    float mean[4] = {}, covariance[4][4] = {};
+    for (int i = 0; i < 16; i++)
+      for (int c = 0; c < channels; c++)
+        mean[c] += block[4 * i + c] / 16.0f;
+    for (int i = 0; i < 16; i++)
+      for (int a = 0; a < channels; a++)
+        for (int b = 0; b < channels; b++)
+          covariance[a][b] += (block[4 * i + a] - mean[a]) * (block[4 * i + b] - mean[b]);
+    float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+      float next[4] = {}, length = 0;
+      for (int a = 0; a < channels; a++)
+      {
+        for (int b = 0; b < channels; b++)
+          next[a] += covariance[a][b] * axis[b];
+        length = std::max(length, std::fabs(next[a]));
+      }
+      if (length == 0)
+        break; // All the texels are equal
+      for (int c = 0; c < channels; c++)
+        axis[c] = next[c] / length;
+    }
+
+    float norm = 0, minT = INFINITY, maxT = -INFINITY;
+    for (int c = 0; c < channels; c++)
+      norm += axis[c] * axis[c];
+    for (int i = 0; i < 16; i++)
+    {
+      float t = 0;
+      for (int c = 0; c < channels; c++)
+        t += (block[4 * i + c] - mean[c]) * axis[c];
+      minT = std::min(minT, t / norm);
+      maxT = std::max(maxT, t / norm);
+    }
+    for (int c = 0; c < 4; c++)
+    {
+      lo[c] = c < channels ? clamp255(mean[c] + minT * axis[c]) : 255.0f;
+      hi[c] = c < channels ? clamp255(mean[c] + maxT * axis[c]) : 255.0f;
+    }
+  }
+
+  static float assignIndices(const uint8_t block[64], int channels, const float (*palette)[4], int colors, uint8_t indices[16])
+  {
+    // Nearest color of the palette for each texel, returns the total squared error
+    float total = 0;
+    for (int i = 0; i < 16; i++)
+    {
+      float best = INFINITY;
+      for (int k = 0; k < colors; k++)
+      {
+        float error = 0;
+        for (int c = 0; c < channels; c++)
+        {
+          float d = block[4 * i + c] - palette[k][c];
+          error += d * d;
+        }
+        if (error < best)
+        {
+          best = error;
+          indices[i] = k;
+        }
+      }
+      total += best;
+    }
+    return total;
+  }
+
+  static bool refit(const uint8_t block[64], int channels, const uint8_t indices[16], const float *weights, float first[4], float second[4])
+  {
+    // Endpoints minimizing sum |(1 - w) first + w second - texel|^2 for the given weights, false when singular
+    float aa = 0, ab = 0, bb = 0, ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+      float b = weights[indices[i]], a = 1.0f - b;
+      aa += a * a;
+      ab += a * b;
+      bb += b * b;
+      for (int c = 0; c < channels; c++)
+      {
+        ax[c] += a * block[4 * i + c];
+        bx[c] += b * block[4 * i + c];
+      }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f)
+      return false;
+    for (int c = 0; c < channels; c++)
+    {
+      first[c] = clamp255((bb * ax[c] - ab * bx[c]) / determinant);
+      second[c] = clamp255((aa * bx[c] - ab * ax[c]) / determinant);
+    }
+    return true;
+  }
+
+  static float clamp255(float value)
+  {
+    return std::min(std::max(value, 0.0f), 255.0f);
+  }
+
+  static uint16_t pack565(const float color[4])
+  {
+    int r = (int)std::lround(color[0] * 31 / 255), g = (int)std::lround(color[1] * 63 / 255), b = (int)std::lround(color[2] * 31 / 255);
+    return (uint16_t)(r << 11 | g << 5 | b);
+  }
+
+  static void bc1Palette(const uint16_t colors[2], float palette[4][4])
+  {
+    for (int e = 0; e < 2; e++)
+    {
+      int r = colors[e] >> 11, g = colors[e] >> 5 & 63, b = colors[e] & 31;
+      palette[e][0] = (float)(r << 3 | r >> 2);
+      palette[e][1] = (float)(g << 2 | g >> 4);
+      palette[e][2] = (float)(b << 3 | b >> 2);
+      palette[e][3] = 255.0f;
+    }
+    for (int c = 0; c < 4; c++)
+    {
+      palette[2][c] = std::floor((2 * palette[0][c] + palette[1][c]) / 3);
+      palette[3][c] = std::floor((palette[0][c] + 2 * palette[1][c]) / 3);
+    }
+  }
+
+  static void quantizeMode6(const float endpoint[4], uint8_t quantized[4], uint8_t &p)
+  {
+    // 7 bits for each channel plus a low bit shared by the channels: the one with the lowest error
+    float bestError = INFINITY;
+    for (int bit = 0; bit < 2; bit++)
+    {
+      uint8_t candidate[4];
+      float error = 0;
+      for (int c = 0; c < 4; c++)
+      {
+        int q = std::min(std::max((int)std::lround((endpoint[c] - bit) / 2), 0), 127);
+        candidate[c] = (uint8_t)q;
+        float d = endpoint[c] - (q << 1 | bit);
+        error += d * d;
+      }
+      if (error < bestError)
+      {
+        bestError = error;
+        memcpy(quantized, candidate, 4);
+        p = (uint8_t)bit;
+      }
+    }
+  }
+
+  static void putBits(uint8_t out[16], int &bit, uint32_t value, int count)
+  {
+    for (int i = 0; i < count; i++, bit++)
+      if (value >> i & 1)
+        out[bit / 8] |= (uint8_t)(1 << (bit % 8));
+  }
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <glm/glm.hpp>
+
+class Frustum
+{
+  /**
+   * The six planes of the view volume of a view-projection matrix (Vulkan clip space: depth from 0 to 1),
+   * in world coordinates, used to cull the objects out of the view.
+   */
+public:
+  Frustum(const glm::mat4 &viewPrj)
+  {
+    // Rows of the matrix (glm is column major): a point is inside when -w <= x, y <= w and 0 <= z <= w
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+      row[i] = glm::vec4(viewPrj[0][i], viewPrj[1][i], viewPrj[2][i], viewPrj[3][i]);
+    planes[0] = row[3] + row[0]; // left
+    planes[1] = row[3] - row[0]; // right
+    planes[2] = row[3] + row[1]; // bottom (top with the flipped Y of Vulkan)
+    planes[3] = row[3] - row[1]; // top
+    planes[4] = row[2];          // near
+    planes[5] = row[3] - row[2]; // far
+  }
+
+  bool intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+  {
+    // The box is out when its corner farthest along the normal of a plane is behind it.
+    // Conservative: a box near a frustum corner can be kept even if outside
+    for (const glm::vec4 &plane : planes)
+    {
+      glm::vec3 corner(plane.x >= 0 ? boxMax.x : boxMin.x, plane.y >= 0 ? boxMax.y : boxMin.y, plane.z >= 0 ? boxMax.z : boxMin.z);
+      if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0)
+        return false;
+    }
+    return true;
+  }
+
+private:
+  glm::vec4 planes[6];
+};
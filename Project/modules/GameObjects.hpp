@@ -61,7 +61,7 @@ public:
         //newPosition = newPosition + MOVE_SPEED * movement.y * glm::vec3(0, 1, 0) * duration; // Uncomment this line to enable vertical movement
         newPosition = newPosition + MOVE_SPEED * movement.z * uz * duration;
 
-        if (checkMazeCollision(position, rotationAlpha, newPosition, newRotationAlpha, maze) && checkBoundary(newPosition) && checkCupCollision(newPosition) )
+        if (checkMazeCollision(position, rotationAlpha, newPosition, newRotationAlpha, maze->getMazeView()) && checkBoundary(newPosition) && checkCupCollision(newPosition) )
         {
             rotationAlpha = newRotationAlpha;
             rotationBeta = newRotationBeta;
@@ -97,7 +97,7 @@ public:
 
         if (glm::distance(glm::vec2(maze->getEndPoint().c * UNITARY_SCALE, maze->getEndPoint().r * UNITARY_SCALE), glm::vec2(position.x, position.z)) <= DISTANCE_CHECK_PLAYER_TELEPORT){
 
-            for (Key key : *maze->getMazeKeys()){
+            for (const Key &key : maze->getMazeKeys()){
                 if(!key.isTaken)
                     return;
             }
@@ -147,10 +147,10 @@ private:
     //     );
     // }
 
-    bool checkMazeCollision(glm::vec3 oldPosition, float oldRotationAlpha, glm::vec3 newPosition, float newRotationAlpha, Maze *maze)
+    bool checkMazeCollision(glm::vec3 oldPosition, float oldRotationAlpha, glm::vec3 newPosition, float newRotationAlpha, const MazeView &maze)
     {
         // Don't collide if on another height
-        if (newPosition.y < 0.0f || newPosition.y > mazeBlockEdgeSize * maze->get3DHeight())
+        if (newPosition.y < 0.0f || newPosition.y > mazeBlockEdgeSize * maze.get3DHeight())
             return true;
         // Return true if player doesn't collide with maze
         Rect oldPlayerRect = getPlayerRect(oldPosition, oldRotationAlpha);
@@ -181,19 +181,19 @@ private:
         return true;
     }
 
-    std::vector<MazePoint> getMazeBlocksToCheck(Maze *maze)
+    std::vector<MazePoint> getMazeBlocksToCheck(const MazeView &maze)
     {
         // Return the maze blocks to check for collision around the player
         // Find the maze rows and columns in the player zone
         float minRow = glm::max(glm::floor((position.z - CHUNK_SIZE_MAZE_COLLISION_CHECK) / mazeBlockEdgeSize), 0.0f);
-        float maxRow = glm::min(int(glm::ceil((position.z + CHUNK_SIZE_MAZE_COLLISION_CHECK) / mazeBlockEdgeSize)), MAZE_SIZE - 1);
+        float maxRow = glm::min(int(glm::ceil((position.z + CHUNK_SIZE_MAZE_COLLISION_CHECK) / mazeBlockEdgeSize)), maze.getHeight() - 1);
         float minCol = glm::max(glm::floor((position.x - CHUNK_SIZE_MAZE_COLLISION_CHECK) / mazeBlockEdgeSize), 0.0f);
-        float maxCol = glm::min(int(glm::ceil((position.x + CHUNK_SIZE_MAZE_COLLISION_CHECK) / mazeBlockEdgeSize)), MAZE_SIZE - 1);
+        float maxCol = glm::min(int(glm::ceil((position.x + CHUNK_SIZE_MAZE_COLLISION_CHECK) / mazeBlockEdgeSize)), maze.getWidth() - 1);
         std::vector<MazePoint> mazeBlocksToCheck;
         for (int i = minRow; i <= maxRow; i++)
             for (int j = minCol; j <= maxCol; j++)
             {
-                if (maze->getMazeMap()[i][j] == MazeWay::WALL)
+                if (maze.isWall(i, j))
                     mazeBlocksToCheck.push_back({i, j});
             }
         return mazeBlocksToCheck;
@@ -246,7 +246,7 @@ private:
     bool checkKeyTaken(glm::vec3 position, Maze *maze)
     {
         glm::vec3 keyPos;
-        for (Key key : *maze->getMazeKeys())
+        for (Key key : maze->getMazeKeys())
         {    
             if (!key.isTaken)
             {
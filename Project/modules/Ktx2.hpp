@@ -0,0 +1,343 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include "MappedFile.hpp"
+#define KTX2_EXTENSION ".ktx2" // Replaces the extension of the source image
+#define KTX2_FALLBACK_EXTENSION ".rgba8.ktx2" // Of the uncompressed version of a compressed texture, for the GPUs without BC
+#define KTX2_SOURCE_HASH_KEY "MGCGsourceHash" // Key of the content hash of the source image (16 hex digits)
+
+// VkFormat values (the container stores them as they are, so they are usable without the Vulkan headers)
+enum Ktx2Format : uint32_t
+{
+  KTX2_FORMAT_R8G8B8A8_UNORM = 37,
+  KTX2_FORMAT_R8G8B8A8_SRGB = 43,
+  KTX2_FORMAT_BC1_RGB_UNORM = 131,
+  KTX2_FORMAT_BC1_RGB_SRGB = 132,
+  KTX2_FORMAT_BC7_UNORM = 145,
+  KTX2_FORMAT_BC7_SRGB = 146
+};
+
+// Mip level of a KTX2 file: level 0 is the full size one
+struct Ktx2Level
+{
+  uint32_t width;
+  uint32_t height;
+  const uint8_t *data;
+  size_t size;
+};
+
+class Ktx2File
+{
+  /**
+   * Reader and writer of the subset of KTX 2.0 (Khronos texture container) used for the baked textures:
+   * a single 2D image (no array layers, no cube faces) with its whole mip chain, in one of the Ktx2Format
+   * formats, without supercompression. The file is mapped, so the levels can be copied straight from it
+   * into a staging buffer. Levels are stored from the smallest one, as the specification requires.
+   * The key/value data holds the hash of the source image the texture was baked from, so a texture
+   * older than its image can be told apart (see Texture::loadPixels).
+   */
+public:
+  static std::string pathFor(const std::string &sourcePath)
+  {
+    size_t dot = sourcePath.find_last_of('.');
+    size_t slash = sourcePath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+      return sourcePath + KTX2_EXTENSION;
+    return sourcePath.substr(0, dot) + KTX2_EXTENSION;
+  }
+
+  static std::string fallbackPathFor(const std::string &sourcePath)
+  {
+    std::string path = pathFor(sourcePath);
+    return path.substr(0, path.size() - strlen(KTX2_EXTENSION)) + KTX2_FALLBACK_EXTENSION;
+  }
+
+  static bool isCompressed(uint32_t format)
+  {
+    return format != KTX2_FORMAT_R8G8B8A8_UNORM && format != KTX2_FORMAT_R8G8B8A8_SRGB;
+  }
+
+  static bool isSrgb(uint32_t format)
+  {
+    return format == KTX2_FORMAT_R8G8B8A8_SRGB || format == KTX2_FORMAT_BC1_RGB_SRGB || format == KTX2_FORMAT_BC7_SRGB;
+  }
+
+  static uint32_t blockBytes(uint32_t format)
+  {
+    // Bytes of a 4x4 block, or of a texel for the uncompressed formats
+    switch (format)
+    {
+    case KTX2_FORMAT_R8G8B8A8_UNORM:
+    case KTX2_FORMAT_R8G8B8A8_SRGB:
+      return 4;
+    case KTX2_FORMAT_BC1_RGB_UNORM:
+    case KTX2_FORMAT_BC1_RGB_SRGB:
+      return 8;
+    case KTX2_FORMAT_BC7_UNORM:
+    case KTX2_FORMAT_BC7_SRGB:
+      return 16;
+    }
+    return 0;
+  }
+
+  static size_t levelSize(uint32_t format, uint32_t width, uint32_t height)
+  {
+    if (!isCompressed(format))
+      return (size_t)width * height * blockBytes(format);
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+  }
+
+  bool open(const std::string &path)
+  {
+    // False when there is no such file, an exception when it is not a valid baked texture
+    close();
+    try
+    {
+      file.open(path);
+    }
+    catch (const std::runtime_error &)
+    {
+      return false;
+    }
+    Header header;
+    if (file.size() < sizeof(Header))
+      throw std::runtime_error("not a KTX2 file: " + path);
+    memcpy(&header, file.data(), sizeof(Header));
+    if (memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+      throw std::runtime_error("not a KTX2 file: " + path);
+    if (blockBytes(header.vkFormat) == 0 || header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1 ||
+        header.supercompressionScheme != 0 || header.pixelWidth == 0 || header.pixelHeight == 0 || header.levelCount == 0 ||
+        header.levelCount > 32)
+      throw std::runtime_error("unsupported KTX2 texture: " + path);
+    if (file.size() < sizeof(Header) + header.levelCount * sizeof(LevelIndex) || header.kvdByteOffset > file.size() ||
+        file.size() - header.kvdByteOffset < header.kvdByteLength)
+      throw std::runtime_error("truncated KTX2 file: " + path);
+
+    format = header.vkFormat;
+    readKeyValues(file.data() + header.kvdByteOffset, header.kvdByteLength, path);
+    for (uint32_t i = 0; i < header.levelCount; i++)
+    {
+      LevelIndex index;
+      memcpy(&index, file.data() + sizeof(Header) + i * sizeof(LevelIndex), sizeof(LevelIndex));
+      Ktx2Level level;
+      level.width = std::max(header.pixelWidth >> i, 1u);
+      level.height = std::max(header.pixelHeight >> i, 1u);
+      level.size = levelSize(format, level.width, level.height);
+      if (index.byteLength != level.size || index.byteOffset > file.size() || file.size() - index.byteOffset < index.byteLength)
+        throw std::runtime_error("corrupted KTX2 file: " + path);
+      level.data = file.data() + index.byteOffset;
+      levels.push_back(level);
+    }
+    return true;
+  }
+
+  void close()
+  {
+    file.close();
+    levels.clear();
+    format = 0;
+    sourceHash = 0;
+  }
+
+  uint32_t getFormat() const
+  {
+    return format;
+  }
+
+  const std::vector<Ktx2Level> &getLevels() const
+  {
+    return levels;
+  }
+
+  uint64_t getSourceHash() const
+  {
+    // 0 when the file does not have it
+    return sourceHash;
+  }
+
+  static bool write(const std::string &path, uint32_t format, const std::vector<Ktx2Level> &levels, const std::string &writer,
+                    uint64_t sourceHash)
+  {
+    // Written to a temporary file and renamed, so a reader never sees a partial texture
+    Header header{};
+    memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+    header.vkFormat = format;
+    header.typeSize = 1;
+    header.pixelWidth = levels[0].width;
+    header.pixelHeight = levels[0].height;
+    header.faceCount = 1;
+    header.levelCount = (uint32_t)levels.size();
+
+    std::vector<uint8_t> dfd = dataFormatDescriptor(format);
+    // The keys sorted by their bytes, as the specification requires
+    char hashText[17];
+    snprintf(hashText, sizeof(hashText), "%016llx", (unsigned long long)sourceHash);
+    std::vector<uint8_t> kvd = keyValue("KTXwriter", writer);
+    std::vector<uint8_t> hashKvd = keyValue(KTX2_SOURCE_HASH_KEY, hashText);
+    kvd.insert(kvd.end(), hashKvd.begin(), hashKvd.end());
+    uint32_t indexEnd = sizeof(Header) + header.levelCount * sizeof(LevelIndex);
+    header.dfdByteOffset = indexEnd;
+    header.dfdByteLength = (uint32_t)dfd.size();
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = (uint32_t)kvd.size();
+
+    // Each level starts at a multiple of the block size and of 4 (the block size for all the formats)
+    size_t alignment = blockBytes(format);
+    std::vector<LevelIndex> index(levels.size());
+    uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+    for (size_t i = levels.size(); i-- > 0;)
+    {
+      offset = (offset + alignment - 1) / alignment * alignment;
+      index[i].byteOffset = offset;
+      index[i].byteLength = levels[i].size;
+      index[i].uncompressedByteLength = levels[i].size;
+      offset += levels[i].size;
+    }
+
+    std::string temporaryPath = path + ".tmp";
+    {
+      std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+      out.write((const char *)&header, sizeof(Header));
+      out.write((const char *)index.data(), index.size() * sizeof(LevelIndex));
+      out.write((const char *)dfd.data(), dfd.size());
+      out.write((const char *)kvd.data(), kvd.size());
+      uint64_t written = header.kvdByteOffset + header.kvdByteLength;
+      for (size_t i = levels.size(); i-- > 0;)
+      {
+        static const char padding[16] = {};
+        out.write(padding, index[i].byteOffset - written);
+        out.write((const char *)levels[i].data, levels[i].size);
+        written = index[i].byteOffset + levels[i].size;
+      }
+      if (!out)
+      {
+        out.close();
+        std::remove(temporaryPath.c_str());
+        return false;
+      }
+    }
+    std::remove(path.c_str()); // rename does not replace an existing file on Windows
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+  }
+
+private:
+  static constexpr uint8_t IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+  struct Header
+  {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+  };
+
+  struct LevelIndex
+  {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+  };
+
+  MappedFile file;
+  uint32_t format = 0;
+  std::vector<Ktx2Level> levels;
+  uint64_t sourceHash = 0;
+
+  static void put32(std::vector<uint8_t> &out, uint32_t value)
+  {
+    for (int i = 0; i < 4; i++)
+      out.push_back((uint8_t)(value >> (8 * i)));
+  }
+
+  static std::vector<uint8_t> dataFormatDescriptor(uint32_t format)
+  {
+    // Basic descriptor block (Khronos Data Format Specification 1.3): one sample for the whole block
+    // of the compressed formats, one for each channel of RGBA8
+    const uint8_t MODEL_RGBSDA = 1, MODEL_BC1A = 128, MODEL_BC7 = 134;
+    const uint8_t PRIMARIES_BT709 = 1, TRANSFER_LINEAR = 1, TRANSFER_SRGB = 2;
+    const uint8_t CHANNEL_ALPHA = 15, QUALIFIER_LINEAR = 0x10;
+    bool compressed = isCompressed(format);
+    int samples = compressed ? 1 : 4;
+    uint32_t blockSize = 24 + 16 * samples;
+
+    std::vector<uint8_t> dfd;
+    put32(dfd, 4 + blockSize);
+    put32(dfd, 0);                   // Khronos vendor, basic descriptor type
+    put32(dfd, 2 | blockSize << 16); // Version 1.3
+    uint8_t model = !compressed ? MODEL_RGBSDA : blockBytes(format) == 8 ? MODEL_BC1A : MODEL_BC7;
+    dfd.push_back(model);
+    dfd.push_back(PRIMARIES_BT709);
+    dfd.push_back(isSrgb(format) ? TRANSFER_SRGB : TRANSFER_LINEAR);
+    dfd.push_back(0); // Straight alpha
+    for (int i = 0; i < 4; i++)
+      dfd.push_back(compressed && i < 2 ? 3 : 0); // Texel block dimensions minus 1
+    dfd.push_back((uint8_t)blockBytes(format));
+    for (int i = 1; i < 8; i++)
+      dfd.push_back(0);
+    for (int s = 0; s < samples; s++)
+    {
+      uint32_t bits = compressed ? 8 * blockBytes(format) : 8;
+      uint8_t channel = compressed ? 0 : s < 3 ? s : CHANNEL_ALPHA;
+      if (!compressed && s == 3 && isSrgb(format))
+        channel |= QUALIFIER_LINEAR; // The alpha is never sRGB encoded
+      put32(dfd, (compressed ? 0 : 8 * s) | (bits - 1) << 16 | (uint32_t)channel << 24);
+      put32(dfd, 0); // Sample position
+      put32(dfd, 0);
+      put32(dfd, compressed ? UINT32_MAX : 255);
+    }
+    return dfd;
+  }
+
+  void readKeyValues(const uint8_t *kvd, uint32_t size, const std::string &path)
+  {
+    // Each pair: its length, the key and the value both ending with a 0, padding to a multiple of 4 bytes
+    uint32_t offset = 0;
+    while (size - offset >= 4)
+    {
+      uint32_t length;
+      memcpy(&length, kvd + offset, 4);
+      offset += 4;
+      if (length > size - offset)
+        throw std::runtime_error("corrupted KTX2 file: " + path);
+      std::string pair((const char *)kvd + offset, length);
+      size_t separator = pair.find('\0');
+      if (separator != std::string::npos && pair.compare(0, separator, KTX2_SOURCE_HASH_KEY) == 0)
+        sourceHash = strtoull(pair.c_str() + separator + 1, nullptr, 16);
+      offset += (length + 3) / 4 * 4;
+      if (offset > size)
+        break;
+    }
+  }
+
+  static std::vector<uint8_t> keyValue(const std::string &key, const std::string &value)
+  {
+    std::vector<uint8_t> kvd;
+    put32(kvd, (uint32_t)(key.size() + value.size() + 2));
+    kvd.insert(kvd.end(), key.begin(), key.end());
+    kvd.push_back(0);
+    kvd.insert(kvd.end(), value.begin(), value.end());
+    kvd.push_back(0);
+    while (kvd.size() % 4 != 0)
+      kvd.push_back(0);
+    return kvd;
+  }
+};
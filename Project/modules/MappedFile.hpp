@@ -0,0 +1,152 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class MappedFile
+{
+  /**
+   * Read-only memory mapping of a whole file.
+   * The pages are loaded by the OS only when they are read and are shared (page cache) with the
+   * other processes mapping the same file, so opening a big file costs almost nothing.
+   */
+public:
+  MappedFile() {}
+
+  MappedFile(const std::string &path)
+  {
+    open(path);
+  }
+
+  ~MappedFile()
+  {
+    close();
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&other)
+  {
+    *this = std::move(other);
+  }
+
+  MappedFile &operator=(MappedFile &&other)
+  {
+    if (this != &other)
+    {
+      close();
+      mappedData = other.mappedData;
+      mappedSize = other.mappedSize;
+#ifdef _WIN32
+      fileHandle = other.fileHandle;
+      mappingHandle = other.mappingHandle;
+      other.fileHandle = INVALID_HANDLE_VALUE;
+      other.mappingHandle = NULL;
+#endif
+      other.mappedData = nullptr;
+      other.mappedSize = 0;
+    }
+    return *this;
+  }
+
+  void open(const std::string &path)
+  {
+    close();
+#ifdef _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+      throw std::runtime_error("failed to open file " + path);
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize))
+    {
+      close();
+      throw std::runtime_error("failed to read the size of file " + path);
+    }
+    mappedSize = (size_t)fileSize.QuadPart;
+    if (mappedSize == 0)
+      return; // Empty files can't be mapped
+    mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle != NULL)
+      mappedData = (const uint8_t *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (mappedData == nullptr)
+    {
+      close();
+      throw std::runtime_error("failed to map file " + path);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("failed to open file " + path);
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0)
+    {
+      ::close(fd);
+      throw std::runtime_error("failed to read the size of file " + path);
+    }
+    mappedSize = (size_t)fileStat.st_size;
+    if (mappedSize > 0)
+    {
+      void *data = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED)
+      {
+        ::close(fd);
+        mappedSize = 0;
+        throw std::runtime_error("failed to map file " + path);
+      }
+      mappedData = (const uint8_t *)data;
+    }
+    ::close(fd); // The mapping stays valid without the file descriptor
+#endif
+  }
+
+  void close()
+  {
+#ifdef _WIN32
+    if (mappedData != nullptr)
+      UnmapViewOfFile(mappedData);
+    if (mappingHandle != NULL)
+      CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+      CloseHandle(fileHandle);
+    mappingHandle = NULL;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (mappedData != nullptr)
+      munmap((void *)mappedData, mappedSize);
+#endif
+    mappedData = nullptr;
+    mappedSize = 0;
+  }
+
+  const uint8_t *data() const
+  {
+    return mappedData;
+  }
+
+  size_t size() const
+  {
+    return mappedSize;
+  }
+
+private:
+  const uint8_t *mappedData = nullptr;
+  size_t mappedSize = 0;
+#ifdef _WIN32
+  HANDLE fileHandle = INVALID_HANDLE_VALUE;
+  HANDLE mappingHandle = NULL;
+#endif
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include "MazeGenerator.hpp"
+#include "ThreadPool.hpp"
+
+struct MazeBatchParameters
+{
+  int width = MAZE_SIZE;
+  int height = MAZE_SIZE;
+  GenerationMode mode = GenerationMode::REJECTION;
+};
+
+class MazeBatchGenerator
+{
+  /**
+   * Generates many mazes at once on a thread pool, one task for each maze.
+   * Every maze has its own random generator, so the result of a seed doesn't depend
+   * on the thread nor on the other mazes of the batch.
+   */
+public:
+  MazeBatchGenerator(ThreadPool &pool) : pool(pool) {}
+
+  std::vector<Maze> generate(const std::vector<uint64_t> &seeds, MazeBatchParameters parameters = MazeBatchParameters())
+  {
+    // The mazes are returned in the same order of the seeds
+    std::vector<Maze> mazes;
+    mazes.reserve(seeds.size());
+    for (uint64_t seed : seeds)
+    {
+      mazes.emplace_back(seed, parameters.width, parameters.height);
+      mazes.back().setVerbose(false);
+      mazes.back().setGenerationMode(parameters.mode);
+    }
+    pool.parallelFor(mazes.size(), [&mazes](size_t i)
+                     { mazes[i].generateMaze(); });
+    return mazes;
+  }
+
+private:
+  ThreadPool &pool;
+};
@@ -0,0 +1,19 @@
+// Constants shared by the C++ code and the shaders (these include it with GL_GOOGLE_include_directive):
+// only #defines and comments, valid both in C++ and in GLSL. The shaders must be compiled again
+// ('make shader') when they change.
+#pragma once
+
+#define KEYS_NUMBER 3
+#define WALL_LIGHTS_NUMBER 6 // Size of the wall lamps arrays of the global uniform block
+
+// Islands of the cube texture atlas, one for each face direction: the origin (u, v) of each one
+// and their side, all in texture coordinates. A face of the maze mesh (see MazeMesher) counts the
+// blocks in its UVs, BoxShader.frag maps the fractional part into the island of the face direction.
+// The lists of two values are meant to be wrapped: vec2(ATLAS_ISLAND_TOP), glm::vec2(ATLAS_ISLAND_TOP)
+#define ATLAS_ISLAND_SIDE 0.3227
+#define ATLAS_ISLAND_TOP 0.3473, 0.3310    // +y
+#define ATLAS_ISLAND_BOTTOM 0.0132, 0.6696 // -y
+#define ATLAS_ISLAND_EAST 0.0246, 0.3310   // +x
+#define ATLAS_ISLAND_WEST 0.6700, 0.3310   // -x
+#define ATLAS_ISLAND_SOUTH 0.3473, 0.0083  // +z
+#define ATLAS_ISLAND_NORTH 0.3473, 0.6537  // -z
@@ -1,15 +1,27 @@
-
+#pragma once
 #include <stdio.h>
 #include <math.h>
 #include <iostream>
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 #include <time.h>
-#define MAZE_SIZE 17  // MAX 800
+#include "MappedFile.hpp"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "MazeConstants.h"
+#define MAZE_SIZE 17  // Default size (the maze size can also be chosen at runtime, see Maze(width, height))
 #define MAZE_HEIGHT 2 // in blocks (for 3D maze)
-#define KEYS_NUMBER 3
-#define WALL_LIGHTS_NUMBER 6
-#define MIN_PATH_BLOCKS MAZE_SIZE *MAZE_SIZE / 3
-#define LIGHT_SQUARE_SIZE 20 // in % wrt the block size
+#define MIN_PATH_BLOCKS_FRACTION 3 // At least 1/MIN_PATH_BLOCKS_FRACTION of the maze cells must be path
+#define MIN_MAZE_SIZE 13           // Smaller mazes can't meet the constraints: the generation would never end
+#define MAX_GENERATIONS 10000      // generateMaze throws after this many generations thrown away
+#define LIGHT_SQUARE_SIZE 20       // in % wrt the block size
 #define TRIVIAL_NODE_PROBABILITY 50
 #define MIN_DEPTH_FOR_A_TRIVIAL_NODE 4
 #define MIN_TTL 5
@@ -21,6 +33,8 @@
 
 #define WALL_LIGHT_FREQUENCY 4
 
+#define MAZE_FILE_VERSION 1
+
 struct MazePoint
 {
   int r;
@@ -42,7 +56,74 @@ enum MazeWay
   PATH = 1,
   START = 2,
   END = 3,
-  PATH_ANALYZED = 4 // For the longest path finding
+  BORDER = 15        // Outside of the maze (grid padding), never equal to any of the above
+};
+
+// The rejected generations grow exponentially with the maze size: REJECTION needs about a thousand of them
+// at 101x101 and reaches MAX_GENERATIONS at 201x201. Beyond about 100x100 only CONSTRAINED works (a single
+// generation, about 2 s at 4096x4096)
+enum GenerationMode
+{
+  REJECTION = 0,  // A maze not meeting the constraints is thrown away and generated again
+  CONSTRAINED = 1 // A maze with too few path cells is mined again from its path cells until it has enough
+};
+
+struct MazeGenerationStats
+{
+  int iterations = 0;    // Full generations (1 if the first one was accepted)
+  int pathRetries = 0;   // Generations thrown away for too few path cells
+  int lightsRetries = 0; // Generations thrown away for the wrong number of lights
+  int extensions = 0;    // Constrained mode: path cells the mining was started again from
+};
+
+struct MazeDistanceField
+{
+  // Result of a breadth-first walk of the maze from a cell (see Maze::computeDistanceField).
+  // Cells are indexed as r * width + c.
+  std::vector<int> distance; // Steps from the first cell, -1 if not reachable (walls)
+  std::vector<int> parent;   // Previous cell on the shortest path to the first cell, -1 for the first cell and walls
+  MazePoint farthest;        // First cell found at the maximum distance
+  int maxDistance = 0;
+};
+
+struct MazeFileHeader
+{
+  /**
+   * Header of a maze in the binary format (numbers are stored as in memory, little endian), followed by:
+   * - cells: width * height bits (1 = wall) row by row, in 64 bit words
+   * - lights: lightsNumber * {int32 r, int32 c, int32 direction}
+   * - keys: keysNumber * {int32 r, int32 c, int32 isTaken}
+   * Many mazes can be stored one after the other in the same file (a maze library).
+   */
+  char magic[4]; // "MAZE"
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint64_t seed;
+  uint32_t generationMode;
+  uint32_t height3D;
+  uint32_t minPathBlocksFraction;
+  uint32_t wallLightFrequency;
+  int32_t startR;
+  int32_t startC;
+  int32_t endR;
+  int32_t endC;
+  uint32_t lightsNumber;
+  uint32_t keysNumber;
+  uint32_t recordSize; // Bytes of the whole maze, header included
+  uint32_t reserved;
+};
+static_assert(sizeof(MazeFileHeader) == 72, "The maze file header must have no padding");
+
+struct MineFrame
+{
+  // A node of the maze mining walk (see Maze::mineMaze)
+  int r;
+  int c;
+  Direction previousDirection;
+  int currentDepth;
+  int timeToLive;
+  bool isFirstDirectionAnalized;
 };
 
 struct Light
@@ -51,78 +132,413 @@ struct Light
   Direction direction;
 };
 
-struct Key 
+struct Key
 {
     MazePoint point;
     bool isTaken;
 };
 
+class MazeRandom
+{
+  /**
+   * xoshiro256** pseudo random generator, one for each maze.
+   * It has no global state nor locks (unlike rand()), so mazes can be generated on many threads
+   * at once, and the same seed always gives the same numbers on any thread and platform.
+   */
+public:
+  MazeRandom(uint64_t seed = 0)
+  {
+    setSeed(seed);
+  }
+
+  void setSeed(uint64_t seed)
+  {
+    // The state is expanded from the seed with splitmix64, so it's never all zeros
+    for (int i = 0; i < 4; i++)
+    {
+      seed += 0x9E3779B97F4A7C15ULL;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      state[i] = z ^ (z >> 31);
+    }
+  }
+
+  uint64_t next()
+  {
+    uint64_t result = rotl(state[1] * 5, 7) * 9;
+    uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 45);
+    return result;
+  }
+
+  int nextInt(int bound)
+  {
+    // Uniform number in [0, bound), from the high bits (the best ones) without a division
+    return (int)(((next() >> 32) * (uint64_t)bound) >> 32);
+  }
+
+private:
+  uint64_t state[4];
+
+  static uint64_t rotl(uint64_t x, int k)
+  {
+    return (x << k) | (x >> (64 - k));
+  }
+};
+
+constexpr uint32_t neighbourhoodWindow(int firstRow, int lastRow, int firstCol, int lastCol)
+{
+  // Bits of a window of a 5x5 neighbourhood (rows and columns from -2 to 2, see MazeGrid::getWallNeighbourhood)
+  uint32_t mask = 0;
+  for (int dr = firstRow; dr <= lastRow; dr++)
+    for (int dc = firstCol; dc <= lastCol; dc++)
+      mask |= 1u << ((dr + 2) * 5 + (dc + 2));
+  return mask;
+}
+
+class MazeGrid
+{
+  /**
+   * Maze cells stored row by row in a single buffer, one byte per cell:
+   * - low nibble: the MazeWay of the cell
+   * - high nibble: the generation history (the Direction bits already analyzed while mining)
+   * The grid is surrounded by a one cell BORDER, so the neighbours of any maze cell
+   * (rows and columns from -1 to size) can be read without bounds checks.
+   * The walls are also kept in a bitmap (one bit per cell, 64 cells for each word, two cells of
+   * padding around the maze), so the mining can test a whole window of cells with a few shifts.
+   */
+public:
+  MazeGrid() {}
+
+  MazeGrid(int width, int height)
+  {
+    resize(width, height);
+  }
+
+  void resize(int width, int height)
+  {
+    this->width = width;
+    this->height = height;
+    stride = width + 2;
+    cells.assign((size_t)stride * (height + 2), BORDER);
+    wordsPerRow = (width + 4) / 64 + 1; // One more word, so 5 bits can always be read from two words
+    reset();
+  }
+
+  void reset()
+  {
+    // All the maze cells become walls with an empty history, the border is left untouched
+    for (int r = 0; r < height; r++)
+      std::fill_n(cells.begin() + index(r, 0), width, (uint8_t)WALL);
+    // Wall bits from padded column 2 to width + 1 of every maze row, the padding is not a wall
+    std::vector<uint64_t> rowBits(wordsPerRow, 0);
+    for (int bit = 2; bit < width + 2; bit++)
+      rowBits[bit >> 6] |= 1ULL << (bit & 63);
+    wallBits.assign((size_t)wordsPerRow * (height + 4), 0);
+    for (int r = 0; r < height; r++)
+      std::copy(rowBits.begin(), rowBits.end(), wallBits.begin() + (size_t)(r + 2) * wordsPerRow);
+  }
+
+  int getWidth() const
+  {
+    return width;
+  }
+
+  int getHeight() const
+  {
+    return height;
+  }
+
+  MazeWay get(int r, int c) const
+  {
+    return (MazeWay)(cells[index(r, c)] & WAY_MASK);
+  }
+
+  void set(int r, int c, MazeWay way)
+  {
+    uint8_t &cell = cells[index(r, c)];
+    cell = (cell & ~WAY_MASK) | way;
+    if (way == MazeWay::WALL)
+      wallWord(r, c) |= wallBit(c);
+    else
+      wallWord(r, c) &= ~wallBit(c);
+  }
+
+  uint32_t getWallNeighbourhood(int r, int c) const
+  {
+    // Walls of the 5x5 cells around a maze cell: bit (dr + 2) * 5 + (dc + 2) is set if (r + dr, c + dc) is a wall
+    uint32_t neighbourhood = 0;
+    for (int i = 0; i < 5; i++)
+    {
+      // Padded row r + i is the maze row r + i - 2, padded column c is the maze column c - 2
+      const uint64_t *row = &wallBits[(size_t)(r + i) * wordsPerRow];
+      int word = c >> 6;
+      int offset = c & 63;
+      uint64_t bits = row[word] >> offset;
+      if (offset > 64 - 5)
+        bits |= row[word + 1] << (64 - offset);
+      neighbourhood |= (uint32_t)(bits & 0x1F) << (i * 5);
+    }
+    return neighbourhood;
+  }
+
+  int getCarvableDirections(int r, int c) const
+  {
+    /**
+     * Directions where a new path cell can be mined from (r, c): the 3x2 cells in front of the new
+     * cell must all be walls (border cells are not walls), and the last two rows and columns of the
+     * maze are never mined. All the four windows are tested at once on the 5x5 neighbourhood.
+     */
+    uint32_t walls = getWallNeighbourhood(r, c);
+    int directions;
+#ifdef __AVX2__
+    const __m128i masks = _mm_setr_epi32(DOWN_WINDOW, RIGHT_WINDOW, LEFT_WINDOW, UP_WINDOW);
+    __m128i windows = _mm_and_si128(_mm_broadcastd_epi32(_mm_cvtsi32_si128(walls)), masks);
+    // One lane for each direction, in the order of the Direction bits
+    directions = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(windows, masks)));
+#else
+    directions = ((walls & DOWN_WINDOW) == DOWN_WINDOW ? DOWN : 0) |
+                 ((walls & RIGHT_WINDOW) == RIGHT_WINDOW ? RIGHT : 0) |
+                 ((walls & LEFT_WINDOW) == LEFT_WINDOW ? LEFT : 0) |
+                 ((walls & UP_WINDOW) == UP_WINDOW ? UP : 0);
+#endif
+    if (r + 2 >= height - 1)
+      directions &= ~DOWN;
+    if (c + 2 >= width - 1)
+      directions &= ~RIGHT;
+    return directions;
+  }
+
+  int getHistory(int r, int c) const
+  {
+    return cells[index(r, c)] >> HISTORY_SHIFT;
+  }
+
+  void addHistory(int r, int c, int directions)
+  {
+    cells[index(r, c)] |= directions << HISTORY_SHIFT;
+  }
+
+  void clearHistory(int r, int c)
+  {
+    cells[index(r, c)] &= WAY_MASK;
+  }
+
+  size_t index(int r, int c) const
+  {
+    return (size_t)(r + 1) * stride + (c + 1);
+  }
+
+private:
+  static const uint8_t WAY_MASK = 0x0F;
+  static const int HISTORY_SHIFT = 4;
+
+  static constexpr uint32_t DOWN_WINDOW = neighbourhoodWindow(1, 2, -1, 1);
+  static constexpr uint32_t RIGHT_WINDOW = neighbourhoodWindow(-1, 1, 1, 2);
+  static constexpr uint32_t LEFT_WINDOW = neighbourhoodWindow(-1, 1, -2, -1);
+  static constexpr uint32_t UP_WINDOW = neighbourhoodWindow(-2, -1, -1, 1);
+
+  int width = 0;
+  int height = 0;
+  int stride = 0;
+  int wordsPerRow = 0;
+  std::vector<uint8_t> cells;
+  std::vector<uint64_t> wallBits;
+
+  uint64_t &wallWord(int r, int c)
+  {
+    return wallBits[(size_t)(r + 2) * wordsPerRow + ((c + 2) >> 6)];
+  }
+
+  static uint64_t wallBit(int c)
+  {
+    return 1ULL << ((c + 2) & 63);
+  }
+};
+
+class MazeView
+{
+  /**
+   * Read-only view of a maze: it doesn't own nor copy anything, so it can be passed by value
+   * to rendering, physics and the visualiser. It's valid as long as the Maze it comes from
+   * (see Maze::getMazeView) and always sees its current state.
+   */
+public:
+  MazeView(const MazeGrid &grid, const std::vector<Light> &lights, const std::vector<Key> &keys,
+           const MazePoint &startPoint, const MazePoint &endPoint)
+      : grid(&grid), lights(&lights), keys(&keys), startPoint(&startPoint), endPoint(&endPoint) {}
+
+  int getWidth() const
+  {
+    return grid->getWidth();
+  }
+
+  int getHeight() const
+  {
+    return grid->getHeight();
+  }
+
+  MazeWay get(int r, int c) const
+  {
+    return grid->get(r, c);
+  }
+
+  bool isWall(int r, int c) const
+  {
+    return grid->get(r, c) == MazeWay::WALL;
+  }
+
+  const MazeGrid &getGrid() const
+  {
+    return *grid;
+  }
+
+  const std::vector<Light> &getLights() const
+  {
+    return *lights;
+  }
+
+  const std::vector<Key> &getKeys() const
+  {
+    return *keys;
+  }
+
+  MazePoint getStartPoint() const
+  {
+    return *startPoint;
+  }
+
+  MazePoint getEndPoint() const
+  {
+    return *endPoint;
+  }
+
+  int get3DHeight() const
+  {
+    return MAZE_HEIGHT;
+  }
+
+private:
+  const MazeGrid *grid;
+  const std::vector<Light> *lights;
+  const std::vector<Key> *keys;
+  const MazePoint *startPoint;
+  const MazePoint *endPoint;
+};
+
 class Maze
 {
 public:
 
-  Maze(){
-    mazeKeys = new std::vector<Key>();
+  Maze(uint64_t seed, int width = MAZE_SIZE, int height = MAZE_SIZE){
+    this->seed = seed;
+    random.setSeed(seed);
+    mazeWidth = width;
+    mazeHeight = height;
   }
 
-  std::vector<std::vector<MazeWay>> getMazeMap()
+  uint64_t getSeed() const
   {
-    return _mazeMap;
+    // The same seed (and size) always generates the same maze
+    return seed;
+  }
+
+  const MazeGrid &getMazeGrid() const
+  {
+    return mazeGrid;
+  }
+
+  MazeView getMazeView() const
+  {
+    return MazeView(mazeGrid, mazeLights, mazeKeys, startPoint, endPoint);
   }
 
   void generateMaze()
   {
     // Repeat until we have placed the correct number of lights or a minimum
     // number of path cells is reached
-    int generation = 0;
-    while (mazeLights.size() != WALL_LIGHTS_NUMBER || mazeFreePlaces.size() < MIN_PATH_BLOCKS)
+    stats = MazeGenerationStats();
+    if (verbose)
+      std::cout << "Generating maze with seed " << seed << std::endl;
+    size_t minPathBlocks = (size_t)mazeWidth * mazeHeight / MIN_PATH_BLOCKS_FRACTION;
+    while (true)
     {
-      std::cout << "Generation " << ++generation << std::endl;
+      if (stats.iterations == MAX_GENERATIONS)
+        throw std::runtime_error("no valid " + std::to_string(mazeWidth) + "x" + std::to_string(mazeHeight) + " maze with seed " +
+                                 std::to_string(seed) + " in " + std::to_string(MAX_GENERATIONS) + " generations");
+      stats.iterations++;
+      if (verbose)
+        std::cout << "Generation " << stats.iterations << std::endl;
       resetMazeMap();
       resetLights();
       resetKeys();
       // if start is in th middle there will be more branches
-      startPoint.r = MAZE_SIZE / 2; // (rand() % (MAZE_SIZE - 2)) + 1;
-      startPoint.c = MAZE_SIZE / 2; // (rand() % (MAZE_SIZE - 2)) + 1;
-      _mazeMap[startPoint.r][startPoint.c] = MazeWay::START;
+      startPoint.r = mazeHeight / 2; // random.nextInt(mazeHeight - 2) + 1;
+      startPoint.c = mazeWidth / 2;  // random.nextInt(mazeWidth - 2) + 1;
+      mazeGrid.set(startPoint.r, startPoint.c, MazeWay::START);
       mineMaze(startPoint.r, startPoint.c, NONE, 0, -1);
-      _mazeMap[endPoint.r][endPoint.c] = MazeWay::END;
-      scanMaze(startPoint.r, startPoint.c, 0, WALL_LIGHT_FREQUENCY + 1);
-      resetAnalyzedPath();
-      std::cout << "\tPlaced " << mazeLights.size() << " lights" << std::endl;
+      if (generationMode == GenerationMode::CONSTRAINED)
+        extendMaze(minPathBlocks);
+      scanMaze();
+      mazeGrid.set(endPoint.r, endPoint.c, MazeWay::END);
+      if (verbose)
+        std::cout << "\tPlaced " << mazeLights.size() << " lights" << std::endl;
       fixLightsNumber();
       placeKeys();
+      if (mazeFreePlaces.size() < minPathBlocks)
+        stats.pathRetries++;
+      else if (mazeLights.size() != WALL_LIGHTS_NUMBER)
+        stats.lightsRetries++;
+      else
+        break;
     }
-    std::cout << "Generation completed in " << generation << " iterations" << std::endl;
+    if (verbose)
+      std::cout << "Generation completed in " << stats.iterations << " iterations" << std::endl;
     generationComplete = true;
   }
 
-  bool isMazeGenerated()
+  bool isMazeGenerated() const
   {
     return generationComplete;
   }
 
-  std::vector<Light> getMazeLights()
+  const std::vector<Light> &getMazeLights() const
   {
     return mazeLights;
   }
 
-  std::vector<Key>* getMazeKeys()
+  const std::vector<Key> &getMazeKeys() const
   {
     return mazeKeys;
   }
 
-  MazePoint getStartPoint()
+  MazePoint getStartPoint() const
   {
     return startPoint;
   }
 
-  MazePoint getEndPoint()
+  MazePoint getEndPoint() const
   {
     return endPoint;
   }
 
-  int get3DHeight()
+  int getWidth() const
+  {
+    return mazeWidth;
+  }
+
+  int getHeight() const
+  {
+    return mazeHeight;
+  }
+
+  int get3DHeight() const
   {
     return MAZE_HEIGHT;
   }
@@ -130,22 +546,22 @@ public:
   void setKeyAsTaken(Key key)
   {
     bool found = false;
-    int i = 0;
-    while (!found && i < mazeKeys->size())
+    size_t i = 0;
+    while (!found && i < mazeKeys.size())
     {
-      if (mazeKeys->at(i).point.r == key.point.r && mazeKeys->at(i).point.c == key.point.c)
+      if (mazeKeys.at(i).point.r == key.point.r && mazeKeys.at(i).point.c == key.point.c)
       {
-        mazeKeys->at(i).isTaken = true;
+        mazeKeys.at(i).isTaken = true;
         found = true;
       }
       i++;
     }
   }
 
-  int getNumberOfRemainingKeys()
+  int getNumberOfRemainingKeys() const
   {
     int notTakenKeys = 0;
-    for (Key key : *mazeKeys)
+    for (const Key &key : mazeKeys)
     {
       if (!key.isTaken)
       {
@@ -155,28 +571,205 @@ public:
     return notTakenKeys;
   }
 
+  MazeDistanceField computeDistanceField(MazePoint from) const
+  {
+    // Distances of all the cells from a path cell, in one pass and without changing the maze
+    return walkMaze(from, [](int, int, int, int) {});
+  }
+
+  void setGenerationMode(GenerationMode mode)
+  {
+    generationMode = mode;
+  }
+
+  GenerationMode getGenerationMode() const
+  {
+    return generationMode;
+  }
+
+  const MazeGenerationStats &getGenerationStats() const
+  {
+    // Stats of the last generateMaze()
+    return stats;
+  }
+
+  void setVerbose(bool verbose)
+  {
+    // If false nothing is printed while generating (e.g. when generating many mazes at once)
+    this->verbose = verbose;
+  }
+
+  void writeMaze(std::vector<uint8_t> &buffer) const
+  {
+    // Append the maze in the binary format to the buffer
+    size_t cellWords = ((size_t)mazeWidth * mazeHeight + 63) / 64;
+    MazeFileHeader header = {};
+    memcpy(header.magic, "MAZE", 4);
+    header.version = MAZE_FILE_VERSION;
+    header.width = mazeWidth;
+    header.height = mazeHeight;
+    header.seed = seed;
+    header.generationMode = generationMode;
+    header.height3D = MAZE_HEIGHT;
+    header.minPathBlocksFraction = MIN_PATH_BLOCKS_FRACTION;
+    header.wallLightFrequency = WALL_LIGHT_FREQUENCY;
+    header.startR = startPoint.r;
+    header.startC = startPoint.c;
+    header.endR = endPoint.r;
+    header.endC = endPoint.c;
+    header.lightsNumber = mazeLights.size();
+    header.keysNumber = mazeKeys.size();
+    header.recordSize = sizeof(MazeFileHeader) + cellWords * sizeof(uint64_t) + (mazeLights.size() + mazeKeys.size()) * 3 * sizeof(int32_t);
+
+    size_t offset = buffer.size();
+    buffer.resize(offset + header.recordSize, 0);
+    uint8_t *out = buffer.data() + offset;
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    std::vector<uint64_t> cells(cellWords, 0);
+    for (int r = 0; r < mazeHeight; r++)
+      for (int c = 0; c < mazeWidth; c++)
+        if (mazeGrid.get(r, c) == MazeWay::WALL)
+        {
+          size_t bit = (size_t)r * mazeWidth + c;
+          cells[bit / 64] |= 1ULL << (bit % 64);
+        }
+    memcpy(out, cells.data(), cellWords * sizeof(uint64_t));
+    out += cellWords * sizeof(uint64_t);
+    for (const Light &light : mazeLights)
+    {
+      int32_t record[3] = {light.point.r, light.point.c, light.direction};
+      memcpy(out, record, sizeof(record));
+      out += sizeof(record);
+    }
+    for (const Key &key : mazeKeys)
+    {
+      int32_t record[3] = {key.point.r, key.point.c, key.isTaken};
+      memcpy(out, record, sizeof(record));
+      out += sizeof(record);
+    }
+  }
+
+  void saveMaze(const std::string &path) const
+  {
+    std::vector<uint8_t> buffer;
+    writeMaze(buffer);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write((const char *)buffer.data(), buffer.size()))
+      throw std::runtime_error("failed to write maze file " + path);
+  }
+
+  size_t readMaze(const uint8_t *data, size_t size)
+  {
+    /**
+     * Read a maze in the binary format, replacing this one.
+     * Returns the bytes read, so the next maze of a library starts at data + the returned size.
+     */
+    MazeFileHeader header;
+    if (size < sizeof(header))
+      throw std::runtime_error("maze data is too short");
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "MAZE", 4) != 0)
+      throw std::runtime_error("not a maze file");
+    if (header.version != MAZE_FILE_VERSION)
+      throw std::runtime_error("unsupported maze file version " + std::to_string(header.version));
+    if (header.width < MIN_MAZE_SIZE || header.height < MIN_MAZE_SIZE || header.width > INT_MAX || header.height > INT_MAX)
+      throw std::runtime_error("corrupted maze file");
+    size_t cellWords = ((size_t)header.width * header.height + 63) / 64;
+    size_t expectedSize = sizeof(header) + cellWords * sizeof(uint64_t) + ((size_t)header.lightsNumber + header.keysNumber) * 3 * sizeof(int32_t);
+    if (header.recordSize != expectedSize || size < expectedSize ||
+        header.startR < 0 || header.startR >= (int32_t)header.height || header.startC < 0 || header.startC >= (int32_t)header.width ||
+        header.endR < 0 || header.endR >= (int32_t)header.height || header.endC < 0 || header.endC >= (int32_t)header.width)
+      throw std::runtime_error("corrupted maze file");
+    // The lights and keys index the grid: all of them are checked before anything is replaced
+    const uint8_t *records = data + sizeof(header) + cellWords * sizeof(uint64_t);
+    for (size_t i = 0; i < (size_t)header.lightsNumber + header.keysNumber; i++)
+    {
+      int32_t record[3];
+      memcpy(record, records + i * sizeof(record), sizeof(record));
+      bool isLight = i < header.lightsNumber;
+      if (record[0] < 0 || record[0] >= (int32_t)header.height || record[1] < 0 || record[1] >= (int32_t)header.width ||
+          (isLight && record[2] != DOWN && record[2] != RIGHT && record[2] != LEFT && record[2] != UP))
+        throw std::runtime_error("corrupted maze file");
+    }
+
+    seed = header.seed;
+    random.setSeed(seed);
+    generationMode = (GenerationMode)header.generationMode;
+    mazeWidth = header.width;
+    mazeHeight = header.height;
+    resetMazeMap();
+    resetKeys();
+    const uint8_t *in = data + sizeof(header);
+    for (int r = 0; r < mazeHeight; r++)
+      for (int c = 0; c < mazeWidth; c++)
+      {
+        size_t bit = (size_t)r * mazeWidth + c;
+        uint64_t word;
+        memcpy(&word, in + bit / 64 * sizeof(uint64_t), sizeof(word));
+        if (!(word >> (bit % 64) & 1))
+        {
+          mazeGrid.set(r, c, MazeWay::PATH);
+          mazeFreePlaces.push_back({r, c});
+        }
+      }
+    in += cellWords * sizeof(uint64_t);
+    startPoint = {header.startR, header.startC};
+    endPoint = {header.endR, header.endC};
+    mazeGrid.set(startPoint.r, startPoint.c, MazeWay::START);
+    mazeGrid.set(endPoint.r, endPoint.c, MazeWay::END);
+    for (uint32_t i = 0; i < header.lightsNumber; i++)
+    {
+      int32_t record[3];
+      memcpy(record, in, sizeof(record));
+      in += sizeof(record);
+      mazeLights.push_back({{record[0], record[1]}, (Direction)record[2]});
+    }
+    for (uint32_t i = 0; i < header.keysNumber; i++)
+    {
+      int32_t record[3];
+      memcpy(record, in, sizeof(record));
+      in += sizeof(record);
+      mazeKeys.push_back({{record[0], record[1]}, record[2] != 0});
+    }
+    stats = MazeGenerationStats();
+    generationComplete = true;
+    return header.recordSize;
+  }
+
+  void loadMaze(const std::string &path)
+  {
+    // Load the first maze of a maze file
+    MappedFile file(path);
+    readMaze(file.data(), file.size());
+  }
+
+  void setGenerationStepCallback(void (*callback)())
+  {
+    // Called every time a cell is mined or a key is placed (used to draw the generation)
+    generationStepCallback = callback;
+  }
+
 private:
   int blockSize;
-  std::vector<std::vector<MazeWay>> _mazeMap;
-  int lunghezzaMax = 0;
+  uint64_t seed;
+  MazeRandom random; // Used for every random choice of the generation
+  int mazeWidth;
+  int mazeHeight;
+  MazeGrid mazeGrid; // Cells and generation history
   MazePoint endPoint;
   MazePoint startPoint;
-  int generationHistory[MAZE_SIZE][MAZE_SIZE]; // bit (LSB) 1 = down, bit 2 = right, bit 3 = left, bit 4 = up
 
   bool generationComplete = false;
+  bool verbose = true;
+  GenerationMode generationMode = GenerationMode::REJECTION;
+  MazeGenerationStats stats;
+  void (*generationStepCallback)() = nullptr;
 
   std::vector<Light> mazeLights;
-  std::vector<Key>* mazeKeys;
+  std::vector<Key> mazeKeys;
   std::vector<MazePoint> mazeFreePlaces; // just for construction
-
-  void resetAnalyzedPath()
-  {
-    // Set back the analyzed path to path after the longest path is found
-    for (int a = 0; a < MAZE_SIZE; a++)
-      for (int b = 0; b < MAZE_SIZE; b++)
-        if (_mazeMap[a][b] == PATH_ANALYZED)
-          _mazeMap[a][b] = PATH;
-  }
+  std::vector<MineFrame> mineStack;      // just for construction, reused between generations
 
   void resetLights()
   {
@@ -185,7 +778,7 @@ private:
 
   void resetKeys()
   {
-    mazeKeys->clear();
+    mazeKeys.clear();
   }
 
   void placeKeys()
@@ -194,13 +787,16 @@ private:
     int keysPlaced = 0;
     while (keysPlaced < KEYS_NUMBER)
     {
-      int randPos = rand() % mazeFreePlaces.size();
+      int randPos = random.nextInt(mazeFreePlaces.size());
       MazePoint keyPoint = mazeFreePlaces.at(randPos);
-      if (_mazeMap[keyPoint.r][keyPoint.c] == MazeWay::PATH) // No on wall, start or end
+      if (mazeGrid.get(keyPoint.r, keyPoint.c) == MazeWay::PATH) // No on wall, start or end
       {
-        mazeKeys->push_back({keyPoint, false});
-        std::cout << "\tKey placed at " << keyPoint.r << ", " << keyPoint.c << std::endl;
+        mazeKeys.push_back({keyPoint, false});
+        if (verbose)
+          std::cout << "\tKey placed at " << keyPoint.r << ", " << keyPoint.c << std::endl;
         keysPlaced++;
+        if (generationStepCallback)
+          generationStepCallback();
       }
     }
   }
@@ -210,16 +806,17 @@ private:
     // Make the lights number be the maximum allowed
     if (mazeLights.size() > WALL_LIGHTS_NUMBER)
     {
-      std::cout << "\tRemoving " << mazeLights.size() - WALL_LIGHTS_NUMBER << " lights to have the correct number" << std::endl;
-      while (mazeLights.size() > WALL_LIGHTS_NUMBER)
-      {
-        int randPos = rand() % mazeLights.size();
-        mazeLights.erase(mazeLights.begin() + randPos);
-      }
+      if (verbose)
+        std::cout << "\tRemoving " << mazeLights.size() - WALL_LIGHTS_NUMBER << " lights to have the correct number" << std::endl;
+      // WALL_LIGHTS_NUMBER random lights moved to the front (partial Fisher-Yates shuffle), the others dropped
+      for (size_t i = 0; i < WALL_LIGHTS_NUMBER; i++)
+        std::swap(mazeLights[i], mazeLights[i + random.nextInt(mazeLights.size() - i)]);
+      mazeLights.resize(WALL_LIGHTS_NUMBER);
     }
     else if (mazeLights.size() < WALL_LIGHTS_NUMBER)
     {
-      std::cout << "\tAdding " << WALL_LIGHTS_NUMBER - mazeLights.size() << " lights to have the correct number" << std::endl;
+      if (verbose)
+        std::cout << "\tAdding " << WALL_LIGHTS_NUMBER - mazeLights.size() << " lights to have the correct number" << std::endl;
 
       // Remove places with lights from the list of free maze places
       std::vector<MazePoint> darkPath;
@@ -233,30 +830,32 @@ private:
 
       while (mazeLights.size() < WALL_LIGHTS_NUMBER && darkPath.size() > 0)
       {
-        int randPos = rand() % darkPath.size();
+        int randPos = random.nextInt(darkPath.size());
         MazePoint newLightPoint = darkPath.at(randPos);
-        darkPath.erase(darkPath.begin() + randPos);
-        // Get a wall around this point for the light
-        if (newLightPoint.r + 1 < MAZE_SIZE - 1 && _mazeMap[newLightPoint.r + 1][newLightPoint.c] == MazeWay::WALL)
+        darkPath[randPos] = darkPath.back();
+        darkPath.pop_back();
+        // Get a wall around this point for the light (the grid border is never a wall)
+        if (mazeGrid.get(newLightPoint.r + 1, newLightPoint.c) == MazeWay::WALL)
         {
           mazeLights.push_back({{newLightPoint.r, newLightPoint.c}, DOWN});
         }
-        else if (newLightPoint.r - 1 >= 0 && _mazeMap[newLightPoint.r - 1][newLightPoint.c] == MazeWay::WALL)
+        else if (mazeGrid.get(newLightPoint.r - 1, newLightPoint.c) == MazeWay::WALL)
         {
           mazeLights.push_back({{newLightPoint.r, newLightPoint.c}, UP});
         }
-        else if (newLightPoint.c + 1 < MAZE_SIZE - 1 && _mazeMap[newLightPoint.r][newLightPoint.c + 1] == MazeWay::WALL)
+        else if (mazeGrid.get(newLightPoint.r, newLightPoint.c + 1) == MazeWay::WALL)
         {
           mazeLights.push_back({{newLightPoint.r, newLightPoint.c}, RIGHT});
         }
-        else if (newLightPoint.c - 1 >= 0 && _mazeMap[newLightPoint.r][newLightPoint.c - 1] == MazeWay::WALL)
+        else if (mazeGrid.get(newLightPoint.r, newLightPoint.c - 1) == MazeWay::WALL)
         {
           mazeLights.push_back({{newLightPoint.r, newLightPoint.c}, LEFT});
         } // else in this point I don't have a wall (don't place it back in darkPath since we don't need it there)
       }
       if (mazeLights.size() < WALL_LIGHTS_NUMBER)
       {
-        std::cout << "\tNot enough walls to place the correct number of lights" << std::endl;
+        if (verbose)
+          std::cout << "\tNot enough walls to place the correct number of lights" << std::endl;
       }
     }
   }
@@ -276,18 +875,10 @@ private:
 
   void resetMazeMap()
   {
-    _mazeMap.resize(MAZE_SIZE);
-    for (int i = 0; i < MAZE_SIZE; i++)
-    {
-      _mazeMap[i].resize(MAZE_SIZE);
-    }
-    for (int a = 0; a < MAZE_SIZE; a++)
-      for (int b = 0; b < MAZE_SIZE; b++)
-      {
-        _mazeMap[a][b] = MazeWay::WALL;
-        generationHistory[a][b] = 0;
-      }
-    lunghezzaMax = 0;
+    if (mazeGrid.getWidth() != mazeWidth || mazeGrid.getHeight() != mazeHeight)
+      mazeGrid.resize(mazeWidth, mazeHeight);
+    else
+      mazeGrid.reset();
     startPoint = {0, 0};
     endPoint = {0, 0};
     mazeLights.clear();
@@ -297,7 +888,7 @@ private:
   Direction randomDirection(int history)
   {
     // Return a direction (random) not in the history
-    int directionIndex = rand() % 4;
+    int directionIndex = random.nextInt(4);
     int tests = 0;
     while (history & (1 << directionIndex) && tests < 4)
     {
@@ -312,241 +903,254 @@ private:
   }
 
   bool mineMaze(int r, int c, Direction previousDirection, int currentDepth, int timeToLive)
+  {
+    /**
+     * Mine the maze starting from (r, c).
+     * The walk is a depth-first search driven by an explicit stack of frames instead of recursion,
+     * so the depth of the maze is not limited by the thread stack. Every node consumes the random
+     * numbers in the same order the recursive version did, so the same seed gives the same maze.
+     * The stack never holds more frames than the path cells of the maze.
+     */
+    mineStack.clear();
+    enterMineNode(r, c, previousDirection, currentDepth, timeToLive);
+    continueMining();
+    return 0;
+  }
+
+  void extendMaze(size_t minPathBlocks)
+  {
+    /**
+     * Constrained generation: keep mining from the path cells (frontier, in random order) until
+     * the maze has at least minPathBlocks path cells. A path cell is mined again with all its
+     * directions and no time to live, so it grows wherever the walls around it leave room.
+     * Every path cell (also the new ones) is tried at most once: if none can grow, the maze
+     * is rejected as in the rejection mode.
+     */
+    std::vector<MazePoint> frontier = mazeFreePlaces;
+    while (mazeFreePlaces.size() < minPathBlocks && !frontier.empty())
+    {
+      int randPos = random.nextInt(frontier.size());
+      MazePoint point = frontier[randPos];
+      frontier[randPos] = frontier.back();
+      frontier.pop_back();
+      size_t oldPathBlocks = mazeFreePlaces.size();
+      mazeGrid.clearHistory(point.r, point.c);
+      mineStack.push_back({point.r, point.c, NONE, 0, -1, true});
+      continueMining();
+      stats.extensions++;
+      frontier.insert(frontier.end(), mazeFreePlaces.begin() + oldPathBlocks, mazeFreePlaces.end());
+    }
+  }
+
+  void continueMining()
+  {
+    // Mine until the stack of nodes to analyze is empty
+    int r, c;
+    while (!mineStack.empty())
+    {
+      MineFrame &frame = mineStack.back();
+      r = frame.r;
+      c = frame.c;
+      int history = mazeGrid.getHistory(r, c);
+      if (history == 15)
+      {
+        // All the directions of this node have been analyzed: go back to the previous one
+        mineStack.pop_back();
+        continue;
+      }
+      Direction direction;
+      if (history == 0 && UNFAIR_PREVIOUS_DIRECTION)
+      {
+        // At first, ask for a direction that is not the previous one
+        direction = randomDirection(history | frame.previousDirection);
+      }
+      else
+      {
+        // After the first direction, ask for a random direction
+        direction = randomDirection(history);
+      }
+      mazeGrid.addHistory(r, c, direction);
+      if (direction == NONE)
+      {
+        mineStack.pop_back(); // No directions left
+        continue;
+      }
+      // The 3x2 cells in front of the new cell must all be walls (see MazeGrid::getCarvableDirections)
+      bool mazeWasChanged = mazeGrid.getCarvableDirections(r, c) & direction;
+      if (mazeWasChanged)
+      {
+        switch (direction)
+        {
+        case DOWN:
+          r = r + 1;
+          break;
+        case RIGHT:
+          c = c + 1;
+          break;
+        case LEFT:
+          c = c - 1;
+          break;
+        case UP:
+          r = r - 1;
+          break;
+        case NONE:
+          break;
+        }
+      }
+      bool isFirstDirectionAnalized = frame.isFirstDirectionAnalized;
+      frame.isFirstDirectionAnalized = false;
+      if (mazeWasChanged)
+      {
+        int childTimeToLive = frame.timeToLive - 1;
+        if (USE_TTL_JUST_ON_FIRST_DIRECTION_ANALIZED && !isFirstDirectionAnalized)
+          childTimeToLive = -1;
+        // Pushing the child may reallocate the stack: frame must not be used after this call
+        enterMineNode(r, c, direction, frame.currentDepth, childTimeToLive);
+      }
+    }
+  }
+
+  void enterMineNode(int r, int c, Direction previousDirection, int currentDepth, int timeToLive)
   {
     // std::cout << "\tMining maze at " << r << ", " << c << " with TTL: " << timeToLive << std::endl;
     //  Trivial node: if from here the path can't be longer than a specific length (TTL).
-    bool isTrivialNode = rand() % 100 < TRIVIAL_NODE_PROBABILITY && timeToLive < 0 && currentDepth > MIN_DEPTH_FOR_A_TRIVIAL_NODE;
+    bool isTrivialNode = random.nextInt(100) < TRIVIAL_NODE_PROBABILITY && timeToLive < 0 && currentDepth > MIN_DEPTH_FOR_A_TRIVIAL_NODE;
     if (isTrivialNode)
     {
-      timeToLive = std::max(MAZE_SIZE - currentDepth, MIN_TTL);
+      timeToLive = std::max(std::max(mazeWidth, mazeHeight) - currentDepth, MIN_TTL);
       // std::cout << "\tTrivial node found at " << r << ", " << c << " with TTL: " << timeToLive << std::endl;
     }
     if (timeToLive == 0)
     { // Lower than 0: no limit, above 0: limit for a next node, equal to 0: no more nodes from here
-      bool ignoreNullTTL = rand() % 100 < IGNORE_NULL_TIME_TO_LIVE_PROBABILITY;
+      bool ignoreNullTTL = random.nextInt(100) < IGNORE_NULL_TIME_TO_LIVE_PROBABILITY;
       if (!ignoreNullTTL)
       {
-        return 0;
+        return;
       }
       // std::cout << "\tIgnoring node at " << r << ", " << c << " with TTL: " << timeToLive << std::endl;
     }
 
     currentDepth++;
+    if (generationStepCallback)
+      generationStepCallback();
 
-    int rOld = r;
-    int cOld = c;
-    _mazeMap[r][c] != MazeWay::START ? _mazeMap[r][c] = MazeWay::PATH : _mazeMap[r][c] = MazeWay::START;
+    mazeGrid.get(r, c) != MazeWay::START ? mazeGrid.set(r, c, MazeWay::PATH) : mazeGrid.set(r, c, MazeWay::START);
     mazeFreePlaces.push_back({r, c});
-    int changedDirections = 0;
-    bool mazeWasChanged;
-    bool isFirstDirectionAnalized = true;
-    while (generationHistory[r][c] != 15)
+    mineStack.push_back({r, c, previousDirection, currentDepth, timeToLive, true});
+  }
+
+  template <typename CellVisitor>
+  MazeDistanceField walkMaze(MazePoint from, CellVisitor visitCell) const
+  {
+    /**
+     * Iterative breadth-first walk of the path cells starting from a cell.
+     * visitCell(cell, parent, r, c) is called once for every reached cell, the parent before its children
+     * (parent is -1 for the first cell). The maze is a tree, so the distance of a cell is also the length
+     * of the only path from the first cell.
+     */
+    MazeDistanceField field;
+    field.distance.assign(mazeWidth * mazeHeight, -1);
+    field.parent.assign(mazeWidth * mazeHeight, -1);
+    field.farthest = from;
+    std::vector<int> queue;
+    queue.reserve(mazeFreePlaces.size() + 1);
+    queue.push_back(from.r * mazeWidth + from.c);
+    field.distance[queue[0]] = 0;
+    const int dr[4] = {1, 0, 0, -1}; // DOWN, RIGHT, LEFT, UP
+    const int dc[4] = {0, 1, -1, 0};
+    for (size_t head = 0; head < queue.size(); head++)
     {
-      Direction direction;
-      if (generationHistory[r][c] == MazeWay::WALL && UNFAIR_PREVIOUS_DIRECTION)
+      int cell = queue[head];
+      int r = cell / mazeWidth;
+      int c = cell % mazeWidth;
+      visitCell(cell, field.parent[cell], r, c);
+      if (field.distance[cell] > field.maxDistance)
       {
-        // At first, ask for a direction that is not the previous one
-        direction = randomDirection(generationHistory[r][c] | previousDirection);
+        field.maxDistance = field.distance[cell];
+        field.farthest = {r, c};
       }
-      else
+      for (int d = 0; d < 4; d++)
       {
-        // After the first direction, ask for a random direction
-        direction = randomDirection(generationHistory[r][c]);
+        // Walls and border (outside of the maze) stop the walk
+        MazeWay way = mazeGrid.get(r + dr[d], c + dc[d]);
+        if (way == MazeWay::WALL || way == MazeWay::BORDER)
+          continue;
+        int next = cell + dr[d] * mazeWidth + dc[d];
+        if (field.distance[next] < 0)
+        {
+          field.distance[next] = field.distance[cell] + 1;
+          field.parent[next] = cell;
+          queue.push_back(next);
+        }
       }
-      generationHistory[r][c] = generationHistory[r][c] | direction;
-      mazeWasChanged = 0;
-      switch (direction)
+    }
+    return field;
+  }
+
+  void scanMaze()
+  {
+    /**
+     * Scan the maze with a single walk from the start:
+     * - the farthest cell from the start becomes the end point
+     * - the lights are placed with the correct frequency along every path from the start
+     */
+    std::vector<int> stepsSinceLastLight(mazeWidth * mazeHeight, 0);
+    MazeDistanceField field = walkMaze(startPoint, [&](int cell, int parent, int r, int c)
+                                       {
+                                         int steps = parent < 0 ? WALL_LIGHT_FREQUENCY + 1 : stepsSinceLastLight[parent] + 1;
+                                         if (steps > WALL_LIGHT_FREQUENCY && placeWallLight(r, c))
+                                           steps = 0;
+                                         stepsSinceLastLight[cell] = steps; });
+    endPoint = field.farthest;
+  }
+
+  bool placeWallLight(int r, int c)
+  {
+    // Place a light on a (random) wall around the cell. If no walls (4 ways from here), skip the placement
+    int lightPlacementDirectionHistory = 0;
+    Direction lightPlacementDirection = randomDirection(lightPlacementDirectionHistory);
+    while (lightPlacementDirection != NONE)
+    {
+      bool canPlace = false;
+      switch (lightPlacementDirection)
       {
       case DOWN:
-        if (_mazeMap[r + 1][c] == MazeWay::WALL && _mazeMap[r + 1][c + 1] == MazeWay::WALL &&
-            _mazeMap[r + 1][c - 1] == MazeWay::WALL)
-          if (r + 2 < MAZE_SIZE - 1 && _mazeMap[r + 2][c] == MazeWay::WALL && _mazeMap[r + 2][c + 1] == MazeWay::WALL &&
-              _mazeMap[r + 2][c - 1] == MazeWay::WALL)
-          {
-            r = r + 1;
-            mazeWasChanged = 1;
-          }
+        canPlace = mazeGrid.get(r + 1, c) == MazeWay::WALL;
         break;
       case RIGHT:
-        if (_mazeMap[r][c + 1] == MazeWay::WALL && _mazeMap[r + 1][c + 1] == MazeWay::WALL &&
-            _mazeMap[r - 1][c + 1] == MazeWay::WALL)
-          if (c + 2 < MAZE_SIZE - 1 && _mazeMap[r][c + 2] == MazeWay::WALL && _mazeMap[r + 1][c + 2] == MazeWay::WALL &&
-              _mazeMap[r - 1][c + 2] == MazeWay::WALL)
-          {
-            c = c + 1;
-            mazeWasChanged = 1;
-          }
+        canPlace = mazeGrid.get(r, c + 1) == MazeWay::WALL;
         break;
       case LEFT:
-        if (_mazeMap[r][c - 1] == MazeWay::WALL && _mazeMap[r + 1][c - 1] == MazeWay::WALL &&
-            _mazeMap[r - 1][c - 1] == MazeWay::WALL)
-          if (c - 2 >= 0 && _mazeMap[r][c - 2] == MazeWay::WALL && _mazeMap[r + 1][c - 2] == MazeWay::WALL &&
-              _mazeMap[r - 1][c - 2] == MazeWay::WALL)
-          {
-            c = c - 1;
-            mazeWasChanged = 1;
-          }
+        canPlace = mazeGrid.get(r, c - 1) == MazeWay::WALL;
         break;
       case UP:
-        if (_mazeMap[r - 1][c] == MazeWay::WALL && _mazeMap[r - 1][c + 1] == MazeWay::WALL &&
-            _mazeMap[r - 1][c - 1] == MazeWay::WALL)
-          if (r - 2 >= 0 && _mazeMap[r - 2][c] == MazeWay::WALL && _mazeMap[r - 2][c + 1] == MazeWay::WALL &&
-              _mazeMap[r - 2][c - 1] == MazeWay::WALL)
-          {
-            r = r - 1;
-            mazeWasChanged = 1;
-          }
+        canPlace = mazeGrid.get(r - 1, c) == MazeWay::WALL;
         break;
       case NONE:
-        return 0; // No directions left
+        break;
       }
-      if (mazeWasChanged == 1)
+      if (canPlace)
       {
-        if (USE_TTL_JUST_ON_FIRST_DIRECTION_ANALIZED)
-        {
-          if (isFirstDirectionAnalized)
-            mineMaze(r, c, direction, currentDepth, timeToLive - 1);
-          else
-            mineMaze(r, c, direction, currentDepth, -1);
-        }
-        else
-        {
-          mineMaze(r, c, direction, currentDepth, timeToLive - 1);
-        }
-        r = rOld;
-        c = cOld;
-        changedDirections++;
+        mazeLights.push_back({{r, c}, lightPlacementDirection});
+        return true;
       }
-      isFirstDirectionAnalized = false;
+      lightPlacementDirectionHistory = lightPlacementDirectionHistory | lightPlacementDirection;
+      lightPlacementDirection = randomDirection(lightPlacementDirectionHistory);
     }
-    return 0;
+    return false;
   }
+};
 
-  bool scanMaze(int r, int c, int lunghezza, int stepsSinceLastLight)
+inline std::vector<Maze> loadMazeLibrary(const std::string &path)
+{
+  // Load all the mazes of a file (mazes written one after the other with Maze::writeMaze)
+  MappedFile file(path);
+  std::vector<Maze> mazes;
+  size_t offset = 0;
+  while (offset < file.size())
   {
-    /**
-     * Scan the maze:
-     * - find the longest path and set the end point
-     * - while walking, place the lights with the correct frequency
-     */
-    Direction scanDirection;
-    int changedDirections = 0;
-    int scanDirectionHistory = 0;
-    bool mazeWasChanged;
-    int rOld = r;
-    int cOld = c;
-    if (_mazeMap[r][c] != MazeWay::WALL)
-    {
-      lunghezza++;
-      if (lunghezza > lunghezzaMax)
-      {
-        lunghezzaMax = lunghezza;
-        endPoint = {r, c};
-      }
-
-      // Check if light placement is needed
-      // std::cout << "\tR,C: " << r << "-" << c << " has light back of " << stepsSinceLastLight << std::endl;
-      if (stepsSinceLastLight > WALL_LIGHT_FREQUENCY)
-      {
-        // Need to check if there's a wall or not in that direction: if not place, otherwise try
-        // to place on another wall.
-        // If no walls (4 ways from here), skip the placement
-        bool canPlace = false;
-        int lightPlacementDirectionHistory = 0;
-        Direction lightPlacementDirection;
-        lightPlacementDirection = randomDirection(lightPlacementDirectionHistory);
-        while (!canPlace && lightPlacementDirection != NONE)
-        {
-          switch (lightPlacementDirection)
-          {
-          case DOWN:
-            if (r + 1 < MAZE_SIZE - 1 && _mazeMap[r + 1][c] == MazeWay::WALL)
-            {
-              canPlace = true;
-            }
-            break;
-          case RIGHT:
-            if (c + 1 < MAZE_SIZE - 1 && _mazeMap[r][c + 1] == MazeWay::WALL)
-            {
-              canPlace = true;
-            }
-            break;
-          case LEFT:
-            if (c - 1 >= 0 && _mazeMap[r][c - 1] == MazeWay::WALL)
-            {
-              canPlace = true;
-            }
-            break;
-          case UP:
-            if (r - 1 >= 0 && _mazeMap[r - 1][c] == MazeWay::WALL)
-            {
-              canPlace = true;
-            }
-            break;
-          case NONE:
-            break;
-          }
-          if (canPlace)
-          {
-            mazeLights.push_back({{r, c}, lightPlacementDirection});
-            stepsSinceLastLight = 0;
-          }
-          lightPlacementDirectionHistory = lightPlacementDirectionHistory | lightPlacementDirection;
-          lightPlacementDirection = randomDirection(lightPlacementDirectionHistory);
-        }
-      }
-
-      while (changedDirections < 4)
-      {
-        scanDirection = randomDirection(scanDirectionHistory);
-        mazeWasChanged = 0;
-        if (_mazeMap[r][c] != MazeWay::START)
-          _mazeMap[r][c] = PATH_ANALYZED; // Set as already analyzed to avoid infinite loops
-        switch (scanDirection)
-        {
-        case DOWN:
-          if (r + 1 < MAZE_SIZE - 1 && _mazeMap[r + 1][c] == 1)
-          {
-            r++;
-            mazeWasChanged = 1;
-          }
-          break;
-        case RIGHT:
-          if (c + 1 < MAZE_SIZE - 1 && _mazeMap[r][c + 1] == 1)
-          {
-            c++;
-            mazeWasChanged = 1;
-          }
-          break;
-        case LEFT:
-          if (c - 1 >= 0 && _mazeMap[r][c - 1] == 1)
-          {
-            c--;
-            mazeWasChanged = 1;
-          }
-          break;
-        case UP:
-          if (r - 1 >= 0 && _mazeMap[r - 1][c] == 1)
-          {
-            r--;
-            mazeWasChanged = 1;
-          }
-          break;
-        case NONE: // No directions left
-          return 0;
-        }
-        if (mazeWasChanged == 1)
-        {
-          scanMaze(r, c, lunghezza, stepsSinceLastLight + 1);
-          r = rOld;
-          c = cOld;
-        }
-        scanDirectionHistory = scanDirectionHistory | scanDirection;
-        changedDirections++;
-      }
-      lunghezza--;
-      return 0;
-    }
-    return 0;
+    mazes.emplace_back(0);
+    offset += mazes.back().readMaze(file.data() + offset, file.size() - offset);
   }
-};
\ No newline at end of file
+  return mazes;
+}
@@ -0,0 +1,208 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "MazeGenerator.hpp"
+#define MAZE_MESH_CHUNK_SIZE 8 // Side, in cells, of the square chunks of the maze mesh
+
+// Same layout of the Vertex of the project (position, normal, UV)
+struct MazeMeshVertex
+{
+  glm::vec3 pos;
+  glm::vec3 norm;
+  glm::vec2 UV;
+};
+
+// Contiguous range of indices with the faces of the walls of a square of cells, and their bounding box
+struct MazeMeshChunk
+{
+  MazePoint firstCell; // Cell of the chunk with the lowest row and column
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  glm::vec3 boundsMin;
+  glm::vec3 boundsMax;
+};
+
+struct MazeMesh
+{
+  std::vector<MazeMeshVertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<MazeMeshChunk> chunks; // Only the chunks with some wall, in rows order
+  int wallBlocks = 0;                // Blocks that the mesh replaces
+};
+
+class MazeMesher
+{
+  /**
+   * Builds a single static mesh with all the walls of a maze.
+   * A wall cell is a column of blocksHeight blocks of side blockSize, centered on (c * blockSize, r * blockSize).
+   * Only the faces that can be seen are generated: the tops and the sides facing a path cell or the outside
+   * (never the bottoms, which lie on the pavement, nor the faces shared by two walls), and the coplanar faces
+   * are merged greedily: rectangles of tops, runs of sides along a row or a column.
+   * The faces are grouped in chunks of chunkSize x chunkSize cells (never merged across two chunks),
+   * so each chunk can be culled and drawn on its own.
+   * The UVs are in blocks units (one texture tile for each block face) and grow as on the cube model,
+   * so BoxShader.frag can repeat the atlas island of the face direction (ATLAS_ISLAND_* in MazeConstants.h)
+   * along the merged faces.
+   */
+public:
+  MazeMesher(float blockSize, int blocksHeight, int chunkSize = MAZE_MESH_CHUNK_SIZE)
+      : blockSize(blockSize), blocksHeight(blocksHeight), chunkSize(chunkSize) {}
+
+  MazeMesh build(const MazeView &maze) const
+  {
+    MazeMesh mesh;
+    int width = maze.getWidth(), height = maze.getHeight();
+
+    for (int r = 0; r < height; r++)
+      for (int c = 0; c < width; c++)
+        if (maze.isWall(r, c))
+          mesh.wallBlocks += blocksHeight;
+
+    std::vector<bool> merged(width * height, false); // Tops already in a rectangle
+    for (int firstR = 0; firstR < height; firstR += chunkSize)
+      for (int firstC = 0; firstC < width; firstC += chunkSize)
+      {
+        int lastR = std::min(firstR + chunkSize, height) - 1, lastC = std::min(firstC + chunkSize, width) - 1;
+        MazeMeshChunk chunk;
+        chunk.firstCell = {firstR, firstC};
+        chunk.firstIndex = (uint32_t)mesh.indices.size();
+        buildChunk(maze, mesh, merged, firstR, lastR, firstC, lastC);
+        chunk.indexCount = (uint32_t)mesh.indices.size() - chunk.firstIndex;
+        chunk.boundsMin = glm::vec3((firstC - 0.5f) * blockSize, 0.0f, (firstR - 0.5f) * blockSize);
+        chunk.boundsMax = glm::vec3((lastC + 0.5f) * blockSize, blocksHeight * blockSize, (lastR + 0.5f) * blockSize);
+        if (chunk.indexCount > 0)
+          mesh.chunks.push_back(chunk);
+      }
+    return mesh;
+  }
+
+private:
+  float blockSize;
+  int blocksHeight;
+  int chunkSize;
+
+  void buildChunk(const MazeView &maze, MazeMesh &mesh, std::vector<bool> &merged, int firstR, int lastR, int firstC, int lastC) const
+  {
+    // Tops: greedy rectangles of wall cells
+    int width = maze.getWidth();
+    for (int r = firstR; r <= lastR; r++)
+      for (int c = firstC; c <= lastC; c++)
+      {
+        if (!maze.isWall(r, c) || merged[r * width + c])
+          continue;
+        int runLastC = c;
+        while (runLastC + 1 <= lastC && maze.isWall(r, runLastC + 1) && !merged[r * width + runLastC + 1])
+          runLastC++;
+        int runLastR = r;
+        while (runLastR + 1 <= lastR && isFreeWallRun(maze, merged, runLastR + 1, c, runLastC))
+          runLastR++;
+        for (int mr = r; mr <= runLastR; mr++)
+          for (int mc = c; mc <= runLastC; mc++)
+            merged[mr * width + mc] = true;
+        addTop(mesh, r, runLastR, c, runLastC);
+      }
+
+    // Sides: runs of wall cells with the same exposed face
+    for (int r = firstR; r <= lastR; r++)
+      for (Direction side : {Direction::UP, Direction::DOWN})
+      {
+        int neighbour = side == Direction::UP ? r - 1 : r + 1;
+        for (int c = firstC; c <= lastC; c++)
+        {
+          if (!isExposed(maze, r, c, neighbour, c))
+            continue;
+          int runLastC = c;
+          while (runLastC + 1 <= lastC && isExposed(maze, r, runLastC + 1, neighbour, runLastC + 1))
+            runLastC++;
+          addRowSide(mesh, r, c, runLastC, side);
+          c = runLastC;
+        }
+      }
+    for (int c = firstC; c <= lastC; c++)
+      for (Direction side : {Direction::LEFT, Direction::RIGHT})
+      {
+        int neighbour = side == Direction::LEFT ? c - 1 : c + 1;
+        for (int r = firstR; r <= lastR; r++)
+        {
+          if (!isExposed(maze, r, c, r, neighbour))
+            continue;
+          int runLastR = r;
+          while (runLastR + 1 <= lastR && isExposed(maze, runLastR + 1, c, runLastR + 1, neighbour))
+            runLastR++;
+          addColumnSide(mesh, c, r, runLastR, side);
+          r = runLastR;
+        }
+      }
+  }
+
+  bool isFreeWallRun(const MazeView &maze, const std::vector<bool> &merged, int r, int firstC, int lastC) const
+  {
+    for (int c = firstC; c <= lastC; c++)
+      if (!maze.isWall(r, c) || merged[r * maze.getWidth() + c])
+        return false;
+    return true;
+  }
+
+  bool isExposed(const MazeView &maze, int r, int c, int neighbourR, int neighbourC) const
+  {
+    // A side of a wall is seen when the next cell is not a wall (the outside of the maze included)
+    if (!maze.isWall(r, c))
+      return false;
+    if (neighbourR < 0 || neighbourR >= maze.getHeight() || neighbourC < 0 || neighbourC >= maze.getWidth())
+      return true;
+    return !maze.isWall(neighbourR, neighbourC);
+  }
+
+  glm::vec2 faceUV(const glm::vec3 &pos, const glm::vec3 &norm) const
+  {
+    // Texture tiles of the cube model faces, V flipped as by the OBJ loader (x and z in blocks starting from the cell border)
+    float x = pos.x / blockSize + 0.5f, y = pos.y / blockSize, z = pos.z / blockSize + 0.5f;
+    if (norm.y > 0.5f)
+      return glm::vec2(-x, -z);
+    if (norm.x > 0.5f)
+      return glm::vec2(y, -z);
+    if (norm.x < -0.5f)
+      return glm::vec2(-y, -z);
+    if (norm.z > 0.5f)
+      return glm::vec2(-x, y);
+    return glm::vec2(-x, -y);
+  }
+
+  void addQuad(MazeMesh &mesh, glm::vec3 origin, glm::vec3 a, glm::vec3 b) const
+  {
+    // Counter clockwise seen from the side cross(a, b) points to
+    glm::vec3 norm = glm::normalize(glm::cross(a, b));
+    uint32_t first = (uint32_t)mesh.vertices.size();
+    for (glm::vec3 pos : {origin, origin + a, origin + a + b, origin + b})
+      mesh.vertices.push_back({pos, norm, faceUV(pos, norm)});
+    for (uint32_t i : {0u, 1u, 2u, 0u, 2u, 3u})
+      mesh.indices.push_back(first + i);
+  }
+
+  void addTop(MazeMesh &mesh, int firstR, int lastR, int firstC, int lastC) const
+  {
+    glm::vec3 origin((firstC - 0.5f) * blockSize, blocksHeight * blockSize, (firstR - 0.5f) * blockSize);
+    addQuad(mesh, origin, glm::vec3(0.0f, 0.0f, (lastR - firstR + 1) * blockSize), glm::vec3((lastC - firstC + 1) * blockSize, 0.0f, 0.0f));
+  }
+
+  void addRowSide(MazeMesh &mesh, int r, int firstC, int lastC, Direction side) const
+  {
+    glm::vec3 run((lastC - firstC + 1) * blockSize, 0.0f, 0.0f);
+    glm::vec3 up(0.0f, blocksHeight * blockSize, 0.0f);
+    if (side == Direction::UP)
+      addQuad(mesh, glm::vec3((firstC - 0.5f) * blockSize, 0.0f, (r - 0.5f) * blockSize), up, run);
+    else
+      addQuad(mesh, glm::vec3((firstC - 0.5f) * blockSize, 0.0f, (r + 0.5f) * blockSize), run, up);
+  }
+
+  void addColumnSide(MazeMesh &mesh, int c, int firstR, int lastR, Direction side) const
+  {
+    glm::vec3 run(0.0f, 0.0f, (lastR - firstR + 1) * blockSize);
+    glm::vec3 up(0.0f, blocksHeight * blockSize, 0.0f);
+    if (side == Direction::LEFT)
+      addQuad(mesh, glm::vec3((c - 0.5f) * blockSize, 0.0f, (firstR - 0.5f) * blockSize), run, up);
+    else
+      addQuad(mesh, glm::vec3((c + 0.5f) * blockSize, 0.0f, (firstR - 0.5f) * blockSize), up, run);
+  }
+};
@@ -0,0 +1,181 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "MazeGenerator.hpp"
+
+class MazeVisibility
+{
+  /**
+   * Cells of the maze that can be seen from a point (on the grid plane), the walls being opaque.
+   * Conservative: a cell is never reported hidden when a segment from the eye reaches it without crossing
+   * a wall (the walls included, their faces being what is seen), but a few hidden cells may be reported.
+   * The cells are visited in square rings around the cell of the eye: a ray from the eye crosses the rings
+   * in order, so only the walls of the inner rings can hide a cell. A cell is hidden when its angular extent,
+   * seen from the exact eye position, is inside the angles covered by the walls of the inner rings.
+   * Angles are pseudo angles, from 0 to 4 counterclockwise starting from the direction of growing columns:
+   * monotonic with the true angle and cheaper than atan2.
+   * Coordinates are in cells: the cell (r, c) is centered in (c, r) and spans half a cell around it.
+   */
+public:
+  bool update(const MazeView &maze, float eyeC, float eyeR, float maxDistance)
+  {
+    // False when the eye is out of the maze: nothing is known about what it can see
+    width = maze.getWidth();
+    height = maze.getHeight();
+    if ((int)visibleStamp.size() != width * height)
+    {
+      visibleStamp.assign(width * height, 0);
+      stamp = 0;
+    }
+    // A new stamp makes all the cells not visible, without clearing
+    if (++stamp == 0)
+    {
+      std::fill(visibleStamp.begin(), visibleStamp.end(), 0);
+      stamp = 1;
+    }
+    visibleCells.clear();
+    hidden.clear();
+
+    int startC = (int)std::floor(eyeC + 0.5f), startR = (int)std::floor(eyeR + 0.5f);
+    if (!isInside(startR, startC))
+      return false;
+    markVisible(startR, startC);
+    if (maze.isWall(startR, startC))
+      return true;
+
+    // The cells of a ring are at least ring - 1 cells away from the eye
+    int lastRing = (int)std::ceil(maxDistance) + 1;
+    for (int ring = 1; ring <= lastRing && !allHidden(); ring++)
+    {
+      ringWalls.clear();
+      for (int side = 0; side < 4; side++)
+        for (int i = -ring; i < ring; i++)
+        {
+          // Each side from a corner of the ring to the next one excluded
+          int r = startR + (side == 0 ? i : side == 1 ? ring : side == 2 ? -i : -ring);
+          int c = startC + (side == 0 ? ring : side == 1 ? -i : side == 2 ? -ring : i);
+          if (isInside(r, c))
+            visitCell(maze, eyeC, eyeR, r, c, maxDistance);
+        }
+      // The walls of a ring hide the cells of the outer rings only
+      for (const AngleRange &range : ringWalls)
+        hide(range);
+    }
+    return true;
+  }
+
+  bool isVisible(int r, int c) const
+  {
+    return isInside(r, c) && visibleStamp[r * width + c] == stamp;
+  }
+
+  const std::vector<MazePoint> &getVisibleCells() const
+  {
+    return visibleCells;
+  }
+
+private:
+  struct AngleRange
+  {
+    float from;
+    float to; // Lower than from when the range contains the angle 0
+  };
+
+  int width = 0;
+  int height = 0;
+  std::vector<uint32_t> visibleStamp;
+  uint32_t stamp = 0;
+  std::vector<MazePoint> visibleCells;
+  std::vector<AngleRange> hidden;    // Angles hidden by the walls of the rings visited, sorted and disjoint
+  std::vector<AngleRange> ringWalls; // Angles of the walls of the current ring
+
+  bool isInside(int r, int c) const
+  {
+    return r >= 0 && r < height && c >= 0 && c < width;
+  }
+
+  void markVisible(int r, int c)
+  {
+    if (visibleStamp[r * width + c] != stamp)
+    {
+      visibleStamp[r * width + c] = stamp;
+      visibleCells.push_back({r, c});
+    }
+  }
+
+  static float pseudoAngle(float dc, float dr)
+  {
+    float p = dr / (std::fabs(dc) + std::fabs(dr));
+    return dc < 0 ? 2.0f - p : dr < 0 ? 4.0f + p : p;
+  }
+
+  void visitCell(const MazeView &maze, float eyeC, float eyeR, int r, int c, float maxDistance)
+  {
+    float minC = c - 0.5f - eyeC, maxC = c + 0.5f - eyeC, minR = r - 0.5f - eyeR, maxR = r + 0.5f - eyeR;
+    float nearC = std::max(std::max(minC, -maxC), 0.0f), nearR = std::max(std::max(minR, -maxR), 0.0f);
+    if (nearC * nearC + nearR * nearR > maxDistance * maxDistance)
+      return;
+
+    // Extent of the angles of the four corners (less than half a turn: the cell does not contain the eye)
+    float corners[4] = {pseudoAngle(minC, minR), pseudoAngle(maxC, minR), pseudoAngle(minC, maxR), pseudoAngle(maxC, maxR)};
+    if (std::isnan(corners[0] + corners[1] + corners[2] + corners[3]))
+    {
+      markVisible(r, c); // The eye is on a corner of the cell
+      return;
+    }
+    AngleRange range = {*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4)};
+    if (range.to - range.from > 2.0f)
+    {
+      range = {4.0f, 0.0f};
+      for (float corner : corners)
+        if (corner >= 2.0f)
+          range.from = std::min(range.from, corner);
+        else
+          range.to = std::max(range.to, corner);
+    }
+    if (isHidden(range))
+      return;
+    markVisible(r, c);
+    // A wall with the eye on the line of one of its sides hides half a turn: ignored, as if it hid nothing
+    if (maze.isWall(r, c) && std::fabs(range.to - range.from) != 2.0f)
+      ringWalls.push_back(range);
+  }
+
+  bool isHidden(const AngleRange &range) const
+  {
+    if (range.to < range.from)
+      return isHidden({range.from, 4.0f}) && isHidden({0.0f, range.to});
+    // The last hidden range starting before the range must contain it
+    auto next = std::upper_bound(hidden.begin(), hidden.end(), range.from,
+                                 [](float angle, const AngleRange &other) { return angle < other.from; });
+    return next != hidden.begin() && (next - 1)->to >= range.to;
+  }
+
+  void hide(const AngleRange &range)
+  {
+    if (range.to < range.from)
+    {
+      hide({range.from, 4.0f});
+      hide({0.0f, range.to});
+      return;
+    }
+    // Merged with the hidden ranges it overlaps or touches (the walls side by side share their corners)
+    auto first = std::lower_bound(hidden.begin(), hidden.end(), range.from,
+                                  [](const AngleRange &other, float angle) { return other.to < angle; });
+    auto last = first;
+    AngleRange merged = range;
+    while (last != hidden.end() && last->from <= range.to)
+    {
+      merged = {std::min(merged.from, last->from), std::max(merged.to, last->to)};
+      last++;
+    }
+    hidden.insert(hidden.erase(first, last), merged);
+  }
+
+  bool allHidden() const
+  {
+    return hidden.size() == 1 && hidden[0].from <= 0.0f && hidden[0].to >= 4.0f;
+  }
+};
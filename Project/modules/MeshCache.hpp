@@ -0,0 +1,154 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <sys/stat.h>
+#include "MappedFile.hpp"
+#define MESH_CACHE_VERSION 2
+#define MESH_CACHE_EXTENSION ".mesh" // Appended to the path of the source model
+
+class MeshCache
+{
+  /**
+   * Binary cache of a loaded model: the final interleaved vertex stream and the indices, ready to be uploaded.
+   * It is written next to the source model the first time this is loaded, and used in its place as long as
+   * the source and the hash of the vertex layout are the ones it was baked with. The source is the same when
+   * its size and modification time are, else when its content hash is (it was only touched).
+   * Layout (little endian): the header, then vertexCount * stride bytes of vertices, then indexCount uint32 indices.
+   */
+public:
+  struct View
+  {
+    // The vertices and indices of a cache, in the memory of its MappedFile: valid while this is open
+    const uint8_t *vertices = nullptr;
+    size_t verticesSize = 0;
+    const uint8_t *indices = nullptr; // uint32 indices, not necessarily aligned
+    uint32_t indexCount = 0;
+  };
+
+  static uint64_t hash(const uint8_t *data, size_t size, uint64_t seed = 0)
+  {
+    // 8 bytes at a time, multiply and xor-shift mixing (not cryptographic, just to detect changes)
+    uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ull);
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++)
+    {
+      uint64_t word;
+      memcpy(&word, data + 8 * i, 8);
+      h = (h ^ word) * 0xFF51AFD7ED558CCDull;
+      h ^= h >> 32;
+    }
+    for (size_t i = 8 * words; i < size; i++)
+      h = (h ^ data[i]) * 0x100000001B3ull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  static uint64_t hashFile(const std::string &path)
+  {
+    MappedFile file(path);
+    return hash(file.data(), file.size());
+  }
+
+  static bool read(const std::string &path, const std::string &sourcePath, uint64_t layoutHash, uint32_t stride,
+                   MappedFile &file, View &view)
+  {
+    // False when there is no valid cache for this source and layout, else the view is in the mapped file
+    try
+    {
+      file.open(path);
+    }
+    catch (const std::runtime_error &)
+    {
+      return false;
+    }
+    Header header;
+    if (file.size() < sizeof(Header))
+      return false;
+    memcpy(&header, file.data(), sizeof(Header));
+    size_t verticesSize = (size_t)header.vertexCount * stride, indicesSize = (size_t)header.indexCount * sizeof(uint32_t);
+    if (memcmp(header.magic, MAGIC, 4) != 0 || header.version != MESH_CACHE_VERSION || header.layoutHash != layoutHash ||
+        header.stride != stride || file.size() != sizeof(Header) + verticesSize + indicesSize)
+      return false;
+    uint64_t sourceSize, sourceTime;
+    if (!sourceStamp(sourcePath, sourceSize, sourceTime) ||
+        ((sourceSize != header.sourceSize || sourceTime != header.sourceTime) && hashFile(sourcePath) != header.sourceHash))
+      return false;
+    if (hash(file.data() + sizeof(Header), verticesSize + indicesSize) != header.contentHash)
+      return false;
+    view.vertices = file.data() + sizeof(Header);
+    view.verticesSize = verticesSize;
+    view.indices = view.vertices + verticesSize;
+    view.indexCount = header.indexCount;
+    return true;
+  }
+
+  static bool write(const std::string &path, const std::string &sourcePath, uint64_t layoutHash, uint32_t stride,
+                    const std::vector<unsigned char> &vertices, const std::vector<uint32_t> &indices)
+  {
+    // Written to a temporary file and renamed, so a reader never sees a partial cache
+    std::vector<uint8_t> content(vertices.size() + indices.size() * sizeof(uint32_t));
+    memcpy(content.data(), vertices.data(), vertices.size());
+    memcpy(content.data() + vertices.size(), indices.data(), indices.size() * sizeof(uint32_t));
+    Header header;
+    memcpy(header.magic, MAGIC, 4);
+    header.version = MESH_CACHE_VERSION;
+    header.stride = stride;
+    header.vertexCount = vertices.size() / stride;
+    header.indexCount = indices.size();
+    if (!sourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+      return false;
+    header.sourceHash = hashFile(sourcePath);
+    header.layoutHash = layoutHash;
+    header.contentHash = hash(content.data(), content.size());
+
+    std::string temporaryPath = path + ".tmp";
+    {
+      std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+      out.write((const char *)&header, sizeof(Header));
+      out.write((const char *)content.data(), content.size());
+      if (!out)
+      {
+        out.close();
+        std::remove(temporaryPath.c_str());
+        return false;
+      }
+    }
+    std::remove(path.c_str()); // rename does not replace an existing file on Windows
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+  }
+
+private:
+  static constexpr char MAGIC[4] = {'M', 'S', 'H', 'C'};
+
+  static bool sourceStamp(const std::string &path, uint64_t &size, uint64_t &time)
+  {
+    // Size and modification time (seconds) of the source
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+      return false;
+    size = (uint64_t)status.st_size;
+    time = (uint64_t)status.st_mtime;
+    return true;
+  }
+
+  struct Header
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t stride;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t padding = 0;
+    uint64_t sourceSize;
+    uint64_t sourceTime;
+    uint64_t sourceHash; // Of the content of the source, checked when its size or time changed
+    uint64_t layoutHash;
+    uint64_t contentHash; // Of vertices and indices, to detect a truncated or corrupted file
+  };
+};
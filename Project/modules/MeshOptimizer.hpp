@@ -0,0 +1,212 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#define MESH_VERTEX_CACHE_SIZE 16 // Post-transform cache entries assumed by Tipsify and by the ACMR
+
+class VertexWelder
+{
+  /**
+   * Builds an indexed vertex buffer from vertices given one at a time (as raw bytes of stride size):
+   * a vertex equal, byte by byte, to one already added gets its index instead of a new copy.
+   * The vertices are found with an open addressing hash table of their indices.
+   */
+public:
+  VertexWelder(std::vector<unsigned char> &vertices, int stride) : vertices(vertices), stride(stride)
+  {
+    table.assign(1024, EMPTY);
+    for (uint32_t i = 0; i < vertices.size() / stride; i++)
+      insert(i);
+  }
+
+  uint32_t add(const unsigned char *vertex)
+  {
+    size_t mask = table.size() - 1;
+    for (size_t slot = hash(vertex) & mask;; slot = (slot + 1) & mask)
+    {
+      if (table[slot] == EMPTY)
+        break;
+      if (memcmp(&vertices[(size_t)table[slot] * stride], vertex, stride) == 0)
+        return table[slot];
+    }
+    uint32_t index = vertices.size() / stride;
+    vertices.insert(vertices.end(), vertex, vertex + stride);
+    insert(index);
+    return index;
+  }
+
+private:
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+
+  std::vector<unsigned char> &vertices;
+  int stride;
+  std::vector<uint32_t> table;
+  size_t used = 0;
+
+  uint64_t hash(const unsigned char *vertex) const
+  {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    for (int i = 0; i < stride; i++)
+      h = (h ^ vertex[i]) * 1099511628211ull;
+    return h;
+  }
+
+  void insert(uint32_t index)
+  {
+    // Kept at most half full, so the probe sequences stay short
+    if (2 * (used + 1) > table.size())
+    {
+      std::vector<uint32_t> old;
+      old.swap(table);
+      table.assign(old.size() * 2, EMPTY);
+      used = 0;
+      for (uint32_t oldIndex : old)
+        if (oldIndex != EMPTY)
+          insert(oldIndex);
+    }
+    size_t mask = table.size() - 1;
+    size_t slot = hash(&vertices[(size_t)index * stride]) & mask;
+    while (table[slot] != EMPTY)
+      slot = (slot + 1) & mask;
+    table[slot] = index;
+    used++;
+  }
+};
+
+class MeshOptimizer
+{
+  /**
+   * Reordering of indexed triangle lists for the GPU vertex caches.
+   * tipsify sorts the triangles so that the vertices are reused while still in the post-transform cache
+   * (Sander, Nehab, Barczak - Fast triangle reordering for vertex locality and reduced overdraw, 2007):
+   * it fans around a vertex, then moves to the vertex of the last triangles that will still be in the cache,
+   * with the most triangles left. reorderVertices then stores the vertices in the order they are first used,
+   * for the pre-transform (memory) cache.
+   * acmr is the average number of vertices transformed for each triangle with a FIFO cache
+   * (3 for an unindexed mesh, 0.5 at best for a regular grid).
+   */
+public:
+  static std::vector<uint32_t> tipsify(const std::vector<uint32_t> &indices, uint32_t vertexCount, int cacheSize = MESH_VERTEX_CACHE_SIZE)
+  {
+    size_t trianglesCount = indices.size() / 3;
+
+    // Triangles of each vertex
+    std::vector<uint32_t> live(vertexCount, 0), firstTriangle(vertexCount + 1, 0);
+    for (uint32_t v : indices)
+      live[v]++;
+    for (uint32_t v = 0; v < vertexCount; v++)
+      firstTriangle[v + 1] = firstTriangle[v] + live[v];
+    std::vector<uint32_t> triangles(indices.size()), filled(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+      triangles[filled[indices[i]]++] = i / 3;
+
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(trianglesCount, false);
+    std::vector<uint32_t> deadEnd, candidates, output;
+    output.reserve(indices.size());
+    int time = cacheSize + 1;
+    uint32_t cursor = 0;
+    int64_t fan = nextLiveVertex(live, cursor);
+    while (fan >= 0)
+    {
+      candidates.clear();
+      for (uint32_t t = firstTriangle[fan]; t < firstTriangle[fan + 1]; t++)
+      {
+        uint32_t triangle = triangles[t];
+        if (emitted[triangle])
+          continue;
+        emitted[triangle] = true;
+        for (int k = 0; k < 3; k++)
+        {
+          uint32_t v = indices[3 * triangle + k];
+          output.push_back(v);
+          deadEnd.push_back(v);
+          candidates.push_back(v);
+          live[v]--;
+          if (time - cacheTime[v] > cacheSize)
+            cacheTime[v] = time++;
+        }
+      }
+      fan = nextVertex(live, cacheTime, time, cacheSize, candidates, deadEnd, cursor);
+    }
+    return output;
+  }
+
+  static void reorderVertices(std::vector<unsigned char> &vertices, int stride, std::vector<uint32_t> &indices)
+  {
+    uint32_t vertexCount = vertices.size() / stride;
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    std::vector<unsigned char> reordered(vertices.size());
+    uint32_t next = 0;
+    for (uint32_t &index : indices)
+    {
+      if (remap[index] == UINT32_MAX)
+      {
+        memcpy(&reordered[(size_t)next * stride], &vertices[(size_t)index * stride], stride);
+        remap[index] = next++;
+      }
+      index = remap[index];
+    }
+    reordered.resize((size_t)next * stride); // Vertices of no triangle are dropped
+    vertices.swap(reordered);
+  }
+
+  static float acmr(const std::vector<uint32_t> &indices, uint32_t vertexCount, int cacheSize = MESH_VERTEX_CACHE_SIZE)
+  {
+    if (indices.empty())
+      return 0.0f;
+    // FIFO cache: a vertex is in it if it entered less than cacheSize misses ago
+    std::vector<int64_t> entered(vertexCount, INT64_MIN / 2);
+    int64_t misses = 0;
+    for (uint32_t v : indices)
+      if (misses - entered[v] >= cacheSize)
+        entered[v] = misses++;
+    return (float)misses / (indices.size() / 3);
+  }
+
+private:
+  static int64_t nextLiveVertex(const std::vector<uint32_t> &live, uint32_t &cursor)
+  {
+    // Next vertex in input order with triangles left
+    while (cursor < live.size())
+    {
+      if (live[cursor] > 0)
+        return cursor;
+      cursor++;
+    }
+    return -1;
+  }
+
+  static int64_t nextVertex(const std::vector<uint32_t> &live, const std::vector<int> &cacheTime, int time, int cacheSize,
+                            const std::vector<uint32_t> &candidates, std::vector<uint32_t> &deadEnd, uint32_t &cursor)
+  {
+    // The candidate with triangles left that is the oldest in the cache, but will still be there once they are emitted
+    int64_t best = -1;
+    int bestPriority = -1;
+    for (uint32_t v : candidates)
+    {
+      if (live[v] == 0)
+        continue;
+      int priority = 0;
+      if (time - cacheTime[v] + 2 * (int)live[v] <= cacheSize)
+        priority = time - cacheTime[v];
+      if (priority > bestPriority)
+      {
+        bestPriority = priority;
+        best = v;
+      }
+    }
+    if (best >= 0)
+      return best;
+    // Dead end: the most recent vertex with triangles left, otherwise the next one in input order
+    while (!deadEnd.empty())
+    {
+      uint32_t v = deadEnd.back();
+      deadEnd.pop_back();
+      if (live[v] > 0)
+        return v;
+    }
+    return nextLiveVertex(live, cursor);
+  }
+};
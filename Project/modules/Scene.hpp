@@ -291,7 +291,7 @@ std::cout << "Scene DS init Done\n";
 
 	//std::cout << "Draw Call\n";						
 				vkCmdDrawIndexed(commandBuffer,
-						static_cast<uint32_t>(M[PI[k].I[i].Mid]->indices.size()), 1, 0, 0, 0);
+						M[PI[k].I[i].Mid]->indexCount, 1, 0, 0, 0);
 			}
 		}
 	}
@@ -23,6 +23,15 @@
 #include <glm/gtx/transform2.hpp>
 
 #include <chrono>
+#include <future>
+#include <functional>
+
+#include "ThreadPool.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshCache.hpp"
+#include "Ktx2.hpp"
+
+#define UNIFORM_ARENA_REGION_SIZE 262144 // Bytes of uniform blocks for each swap chain image
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -217,10 +226,14 @@ struct VertexDescriptor {
 	std::vector<VkVertexInputBindingDescription> getBindingDescription();
 	std::vector<VkVertexInputAttributeDescription>
 						getAttributeDescriptions();
+	uint64_t layoutHash();
 };
 
 enum ModelType {OBJ, GLTF, MGCG};
 
+// Asset loaded with initAsync: ready when its GPU resources have been uploaded (see BaseProject::loadAsync)
+typedef std::shared_future<void> AssetHandle;
+
 class Model {
 	BaseProject *BP;
 	
@@ -229,17 +242,22 @@ class Model {
 	VkBuffer indexBuffer;
 	VkDeviceMemory indexBufferMemory;
 	VertexDescriptor *VD;
+	MappedFile meshCacheFile;	// Open from loadMesh to the creation of the buffers, when the mesh is in the cache
+	MeshCache::View meshCache;	// Uploaded in place of vertices and indices (left empty)
 
 	public:
 	glm::mat4 Wm;
 	std::vector<unsigned char> vertices{};
 	std::vector<uint32_t> indices{};
+	uint32_t indexCount = 0;	// Of the index buffer, set by createIndexBuffer
 	void loadModelOBJ(std::string file);
 	void loadModelGLTF(std::string file, bool encoded);
+	void loadMesh(std::string file, ModelType MT);
 	void createIndexBuffer();
 	void createVertexBuffer();
 
 	void init(BaseProject *bp, VertexDescriptor *VD, std::string file, ModelType MT);
+	AssetHandle initAsync(BaseProject *bp, VertexDescriptor *VD, std::string file, ModelType MT);
 	void initMesh(BaseProject *bp, VertexDescriptor *VD);
 	void cleanup();
   	void bind(VkCommandBuffer commandBuffer);
@@ -254,7 +272,15 @@ struct Texture {
 	VkSampler textureSampler;
 	int imgs;
 	static const int maxImgs = 6;
+	stbi_uc *pixels[maxImgs];	// Decoded by loadPixels, freed once in the staging buffer
+	int texWidth, texHeight;
+	Ktx2File baked;				// Baked version of the image (see textures/TextureBaker.cpp), when found by loadPixels
+	VkFormat format;
 	
+	void loadPixels(std::string files[]);
+	void uploadTextureImage(VkFormat Fmt);
+	void uploadBakedImage(VkFormat Fmt);
+	VkFormat bakedFormat(VkFormat Fmt);
 	void createTextureImage(std::string files[], VkFormat Fmt);
 	void createTextureImageView(VkFormat Fmt);
 	void createTextureSampler(VkFilter magFilter,
@@ -268,6 +294,7 @@ struct Texture {
 							);
 
 	void init(BaseProject *bp, std::string file, VkFormat Fmt, bool initSampler);
+	AssetHandle initAsync(BaseProject *bp, std::string file, VkFormat Fmt, bool initSampler);
 	void initCubic(BaseProject *bp, std::string files[6]);
 	void cleanup();
 };
@@ -323,12 +350,11 @@ struct Pipeline {
 struct DescriptorSet {
 	BaseProject *BP;
 
-	std::vector<std::vector<VkBuffer>> uniformBuffers;
-	std::vector<std::vector<VkDeviceMemory>> uniformBuffersMemory;
+	std::vector<VkDeviceSize> uniformOffsets;	// Of the uniform blocks, in the region of each image of the uniform arena
+	std::vector<int> dynamicBindings;			// The uniform blocks, in the order of their dynamic offsets
+	std::vector<std::vector<uint32_t>> dynamicOffsets;	// For each image, given as they are when the set is bound
 	std::vector<VkDescriptorSet> descriptorSets;
 	DescriptorSetLayout *Layout;
-	
-	std::vector<bool> toFree;
 
 	void init(BaseProject *bp, DescriptorSetLayout *L,
 						 std::vector<Texture *>Txs);
@@ -338,6 +364,41 @@ struct DescriptorSet {
 };
 
 
+struct UniformArena {
+	BaseProject *BP;
+
+	VkBuffer buffer;
+	VkDeviceMemory bufferMemory;
+	uint8_t *mappedData;
+	VkDeviceSize alignment;
+	VkDeviceSize regionSize;
+	VkDeviceSize used;
+	int regionsCount;
+
+	void init(BaseProject *bp, VkDeviceSize regionSize);
+	void cleanup();
+	VkDeviceSize allocate(VkDeviceSize size);
+	void *data(int currentImage, VkDeviceSize offset);
+	uint32_t dynamicOffset(int currentImage, VkDeviceSize offset);
+};
+
+
+struct IndirectBuffer {
+	BaseProject *BP;
+
+	std::vector<VkBuffer> buffers;
+	std::vector<VkDeviceMemory> buffersMemory;
+	std::vector<VkDrawIndexedIndirectCommand *> mappedCommands;
+	int maxDraws;
+	uint32_t maxDrawIndirectCount; // Of the device: longer lists of commands are split in several calls
+
+	void init(BaseProject *bp, int maxDraws);
+	void cleanup();
+	VkDrawIndexedIndirectCommand *commands(int currentImage);
+	void draw(VkCommandBuffer commandBuffer, int currentImage, int drawCount);
+};
+
+
 struct PoolSizes {
 	int uniformBlocksInPool = 0;
 	int texturesInPool = 0;
@@ -352,6 +413,8 @@ class BaseProject {
 	friend class Pipeline;
 	friend class DescriptorSetLayout;
 	friend class DescriptorSet;
+	friend class IndirectBuffer;
+	friend class UniformArena;
 public:
 	virtual void setWindowParameters() = 0;
     void run() {
@@ -384,6 +447,16 @@ protected:
 	VkCommandPool commandPool;
 	std::vector<VkCommandBuffer> commandBuffers;
 
+	// Dynamic recording: the primary command buffer of an image is recorded again at each frame,
+	// executing a cached secondary command buffer with the static part of the scene and
+	// dynamicCommandBuffersParts secondary command buffers recorded in parallel (see recordCommandBuffer)
+	bool dynamicCommandBuffers = false;
+	int dynamicCommandBuffersParts = 1;
+	std::vector<VkCommandBuffer> staticCommandBuffers;
+	std::vector<std::vector<VkCommandPool>> dynamicCommandPools;	   // For each image and part, used by one thread at a time
+	std::vector<std::vector<VkCommandBuffer>> dynamicPartsCommandBuffers; // For each image and part
+	ThreadPool *recordingThreads = nullptr;
+
     VkSwapchainKHR swapChain;
     std::vector<VkImage> swapChainImages;
 	VkFormat swapChainImageFormat;
@@ -401,6 +474,27 @@ protected:
 	VkImageView depthImageView;
 
 	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	bool multiDrawIndirectSupported = false;
+	bool textureCompressionBCSupported = false;
+	UniformArena uniformArena;
+	VkDeviceSize uniformArenaRegionSize = UNIFORM_ARENA_REGION_SIZE;
+
+	// Batched uploads (see beginUploadBatch): the transfers of the resources created
+	// between beginUploadBatch and endUploadBatch are recorded in a single command buffer
+	VkCommandBuffer uploadCommandBuffer = VK_NULL_HANDLE;
+	std::vector<VkBuffer> uploadStagingBuffers;
+	std::vector<VkDeviceMemory> uploadStagingBuffersMemory;
+	VkDeviceSize uploadStagingBytes = 0;
+	std::chrono::steady_clock::time_point uploadBatchStart;
+
+	// Assets loaded with initAsync: decoded or parsed on the asset threads, uploaded in the upload batch
+	struct PendingAsset {
+		std::future<void> loaded;
+		std::function<void()> upload;
+		std::promise<void> uploaded;
+	};
+	std::vector<PendingAsset> pendingAssets;
+	ThreadPool *assetThreads = nullptr;
 	VkImage colorImage;
 	VkDeviceMemory colorImageMemory;
 	VkImageView colorImageView;
@@ -453,9 +547,12 @@ protected:
 		createColorResources();
 		createDepthResources();			
 		createFramebuffers();			
+		beginUploadBatch();
 		localInit();
+		endUploadBatch();
 
 		createDescriptorPool();			
+		uniformArena.init(this, uniformArenaRegionSize);
 		pipelinesAndDescriptorSetsInit();
 
 		createCommandBuffers();			
@@ -842,10 +939,17 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 		
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+		multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect;
+		textureCompressionBCSupported = supportedFeatures.textureCompressionBC;
+
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
 		deviceFeatures.sampleRateShading = VK_TRUE;
 		deviceFeatures.fillModeNonSolid  = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
 		
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -1132,7 +1236,8 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		VkCommandPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-		poolInfo.flags = 0; // Optional
+		// The primary command buffers are reset one by one when they are recorded at each frame
+		poolInfo.flags = dynamicCommandBuffers ? VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT : 0;
 		
 		VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
 		if (result != VK_SUCCESS) {
@@ -1415,8 +1520,37 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 
 		endSingleTimeCommands(commandBuffer);
 	}
+
+	void copyBufferToImageLevels(VkBuffer buffer, VkImage image, uint32_t
+						   width, uint32_t height, const std::vector<VkDeviceSize> &levelOffsets) {
+		// Copies a whole mip chain: the level i starts at levelOffsets[i] in the buffer
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		
+		std::vector<VkBufferImageCopy> regions(levelOffsets.size());
+		for (uint32_t i = 0; i < regions.size(); i++) {
+			regions[i].bufferOffset = levelOffsets[i];
+			regions[i].bufferRowLength = 0;
+			regions[i].bufferImageHeight = 0;
+			regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[i].imageSubresource.mipLevel = i;
+			regions[i].imageSubresource.baseArrayLayer = 0;
+			regions[i].imageSubresource.layerCount = 1;
+			regions[i].imageOffset = {0, 0, 0};
+			regions[i].imageExtent = {std::max(width >> i, 1u), std::max(height >> i, 1u), 1};
+		}
+		
+		vkCmdCopyBufferToImage(commandBuffer, buffer, image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(regions.size()), regions.data());
+
+		endSingleTimeCommands(commandBuffer);
+	}
 	
 	VkCommandBuffer beginSingleTimeCommands() { 
+		if (uploadCommandBuffer != VK_NULL_HANDLE) {
+			return uploadCommandBuffer; // Submitted by endUploadBatch
+		}
+
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -1436,6 +1570,10 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 	}
 	
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+		if (commandBuffer == uploadCommandBuffer) {
+			return;
+		}
+
 		vkEndCommandBuffer(commandBuffer);
 		
 		VkSubmitInfo submitInfo{};
@@ -1448,6 +1586,142 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 	}
 	
+	void beginUploadBatch() {
+		// Until endUploadBatch the single time commands (copies, layout transitions, mipmaps) are only
+		// recorded, and the staging buffers are kept: everything is submitted at once, with one wait
+		uploadBatchStart = std::chrono::steady_clock::now();
+		uploadStagingBytes = 0;
+		uploadCommandBuffer = beginSingleTimeCommands();
+	}
+
+	AssetHandle loadAsync(std::function<void()> load, std::function<void()> upload) {
+		// load runs on the asset threads, upload on this thread when the batch ends, in the order
+		// of the calls: the handle is ready once the upload has been executed
+		PendingAsset asset;
+		AssetHandle handle = asset.uploaded.get_future().share();
+		if (uploadCommandBuffer == VK_NULL_HANDLE) {
+			// Outside an upload batch there is nothing to wait for
+			load();
+			upload();
+			asset.uploaded.set_value();
+			return handle;
+		}
+		if (assetThreads == nullptr) {
+			assetThreads = new ThreadPool();
+		}
+		auto task = std::make_shared<std::packaged_task<void()>>(load);
+		asset.loaded = task->get_future();
+		asset.upload = upload;
+		pendingAssets.push_back(std::move(asset));
+		assetThreads->submit([task]() { (*task)(); });
+		return handle;
+	}
+
+	void endUploadBatch() {
+		// The assets are recorded as soon as they are loaded, while the next ones are still loading
+		for (PendingAsset &asset : pendingAssets) {
+			asset.loaded.get(); // Rethrows the loading errors
+			asset.upload();
+		}
+
+		VkCommandBuffer commandBuffer = uploadCommandBuffer;
+		uploadCommandBuffer = VK_NULL_HANDLE;
+
+		// The copied buffers are read as vertices and indices by the following frames
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+							 VK_PIPELINE_STAGE_TRANSFER_BIT,
+							 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+							 1, &barrier, 0, nullptr, 0, nullptr);
+		vkEndCommandBuffer(commandBuffer);
+		auto recordingEnd = std::chrono::steady_clock::now();
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence uploadFence;
+		VkResult result = vkCreateFence(device, &fenceInfo, nullptr, &uploadFence);
+		if (result != VK_SUCCESS) {
+		 	PrintVkError(result);
+			throw std::runtime_error("failed to create upload fence!");
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, uploadFence);
+		if (result != VK_SUCCESS) {
+		 	PrintVkError(result);
+			throw std::runtime_error("failed to submit upload command buffer!");
+		}
+		vkWaitForFences(device, 1, &uploadFence, VK_TRUE, UINT64_MAX);
+
+		vkDestroyFence(device, uploadFence, nullptr);
+		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+		for (size_t i = 0; i < uploadStagingBuffers.size(); i++) {
+			vkDestroyBuffer(device, uploadStagingBuffers[i], nullptr);
+			vkFreeMemory(device, uploadStagingBuffersMemory[i], nullptr);
+		}
+
+		for (PendingAsset &asset : pendingAssets) {
+			asset.uploaded.set_value();
+		}
+		pendingAssets.clear();
+
+		auto uploadEnd = std::chrono::steady_clock::now();
+		std::cout << "Resources loaded in "
+				  << std::chrono::duration<double, std::milli>(uploadEnd - uploadBatchStart).count() << " ms ("
+				  << std::chrono::duration<double, std::milli>(uploadEnd - recordingEnd).count() << " ms for the upload of "
+				  << uploadStagingBuffers.size() << " staging buffers, " << uploadStagingBytes / (1024.0 * 1024.0) << " MB)\n";
+		uploadStagingBuffers.clear();
+		uploadStagingBuffersMemory.clear();
+	}
+
+	void releaseStagingBuffer(VkBuffer buffer, VkDeviceMemory bufferMemory, VkDeviceSize size) {
+		// In an upload batch the copy from the staging buffer has not been executed yet
+		if (uploadCommandBuffer != VK_NULL_HANDLE) {
+			uploadStagingBuffers.push_back(buffer);
+			uploadStagingBuffersMemory.push_back(bufferMemory);
+			uploadStagingBytes += size;
+			return;
+		}
+		vkDestroyBuffer(device, buffer, nullptr);
+		vkFreeMemory(device, bufferMemory, nullptr);
+	}
+
+	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+		VkBufferCopy copyRegion{};
+		copyRegion.size = size;
+		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+		endSingleTimeCommands(commandBuffer);
+	}
+
+	void createDeviceLocalBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const void *src,
+								 VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+		// Filled with a copy from a staging buffer: the GPU reads it from its own memory
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+		createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+					 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+					 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					 stagingBuffer, stagingBufferMemory);
+		void* data;
+		vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+		memcpy(data, src, (size_t) size);
+		vkUnmapMemory(device, stagingBufferMemory);
+
+		createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+		copyBuffer(stagingBuffer, buffer, size);
+		releaseStagingBuffer(stagingBuffer, stagingBufferMemory, size);
+	}
+	
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
 					  VkMemoryPropertyFlags properties,
 					  VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
@@ -1501,7 +1775,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
     
 	void createDescriptorPool() {
 		std::array<VkDescriptorPoolSize, 2> poolSizes{};
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; // See UniformArena
 		poolSizes[0].descriptorCount = static_cast<uint32_t>(DPSZs.uniformBlocksInPool *
 															 swapChainImages.size());
 		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -1522,7 +1796,11 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		}
 	}
 	
-	virtual void populateCommandBuffer(VkCommandBuffer commandBuffer, int i) = 0;
+	virtual void populateCommandBuffer(VkCommandBuffer commandBuffer, int i) {}
+	// Dynamic recording: the static part is recorded once, the dynamic parts at each frame, after updateUniformBuffer.
+	// The parts are recorded at the same time on different threads: they must only read the state of the application
+	virtual void populateStaticCommandBuffer(VkCommandBuffer commandBuffer, int i) {}
+	virtual void populateDynamicCommandBuffer(VkCommandBuffer commandBuffer, int i, int part) {}
 
     void createCommandBuffers() {
     	commandBuffers.resize(swapChainFramebuffers.size());
@@ -1539,6 +1817,11 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		 	PrintVkError(result);
 			throw std::runtime_error("failed to allocate command buffers!");
 		}
+
+		if (dynamicCommandBuffers) {
+			createDynamicCommandBuffers();
+			return;
+		}
 		
 		for (size_t i = 0; i < commandBuffers.size(); i++) {
 			VkCommandBufferBeginInfo beginInfo{};
@@ -1551,23 +1834,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 				throw std::runtime_error("failed to begin recording command buffer!");
 			}
 			
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass; 
-			renderPassInfo.framebuffer = swapChainFramebuffers[i];
-			renderPassInfo.renderArea.offset = {0, 0};
-			renderPassInfo.renderArea.extent = swapChainExtent;
-	
-			std::array<VkClearValue, 2> clearValues{};
-			clearValues[0].color = initialBackgroundColor;
-			clearValues[1].depthStencil = {1.0f, 0};
-	
-			renderPassInfo.clearValueCount =
-							static_cast<uint32_t>(clearValues.size());
-			renderPassInfo.pClearValues = clearValues.data();
-			
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo,
-					VK_SUBPASS_CONTENTS_INLINE);			
+			beginRenderPass(commandBuffers[i], i, VK_SUBPASS_CONTENTS_INLINE);
 	
 
 			populateCommandBuffer(commandBuffers[i], i);
@@ -1580,6 +1847,134 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 			}
 		}
 	}
+
+	void beginRenderPass(VkCommandBuffer commandBuffer, size_t i, VkSubpassContents contents) {
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass; 
+		renderPassInfo.framebuffer = swapChainFramebuffers[i];
+		renderPassInfo.renderArea.offset = {0, 0};
+		renderPassInfo.renderArea.extent = swapChainExtent;
+
+		std::array<VkClearValue, 2> clearValues{};
+		clearValues[0].color = initialBackgroundColor;
+		clearValues[1].depthStencil = {1.0f, 0};
+
+		renderPassInfo.clearValueCount =
+						static_cast<uint32_t>(clearValues.size());
+		renderPassInfo.pClearValues = clearValues.data();
+		
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+	}
+
+	void beginSecondaryCommandBuffer(VkCommandBuffer commandBuffer, size_t i) {
+		// Secondary command buffers are executed inside the render pass, on the framebuffer of image i
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = swapChainFramebuffers[i];
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+	}
+
+	void createDynamicCommandBuffers() {
+		if (recordingThreads == nullptr) {
+			recordingThreads = new ThreadPool(std::min((unsigned int)dynamicCommandBuffersParts,
+									std::max(std::thread::hardware_concurrency(), 1u)));
+		}
+
+		// The static part is recorded only here, when the swap chain is created
+		staticCommandBuffers.resize(swapChainFramebuffers.size());
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = (uint32_t) staticCommandBuffers.size();
+
+		VkResult result = vkAllocateCommandBuffers(device, &allocInfo,
+				staticCommandBuffers.data());
+		if (result != VK_SUCCESS) {
+		 	PrintVkError(result);
+			throw std::runtime_error("failed to allocate static command buffers!");
+		}
+		for (size_t i = 0; i < staticCommandBuffers.size(); i++) {
+			beginSecondaryCommandBuffer(staticCommandBuffers[i], i);
+			populateStaticCommandBuffer(staticCommandBuffers[i], i);
+			if (vkEndCommandBuffer(staticCommandBuffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record static command buffer!");
+			}
+		}
+
+		// A transient pool for each part of each image: a part is recorded by a single thread,
+		// and its pool is reset as a whole once the image is no longer in flight
+		dynamicCommandPools.resize(swapChainFramebuffers.size());
+		dynamicPartsCommandBuffers.resize(swapChainFramebuffers.size());
+		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+		for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
+			dynamicCommandPools[i].resize(dynamicCommandBuffersParts);
+			dynamicPartsCommandBuffers[i].resize(dynamicCommandBuffersParts);
+			for (int part = 0; part < dynamicCommandBuffersParts; part++) {
+				VkCommandPoolCreateInfo poolInfo{};
+				poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+				poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+				poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+				result = vkCreateCommandPool(device, &poolInfo, nullptr, &dynamicCommandPools[i][part]);
+				if (result != VK_SUCCESS) {
+				 	PrintVkError(result);
+					throw std::runtime_error("failed to create dynamic command pool!");
+				}
+
+				allocInfo.commandPool = dynamicCommandPools[i][part];
+				allocInfo.commandBufferCount = 1;
+				result = vkAllocateCommandBuffers(device, &allocInfo, &dynamicPartsCommandBuffers[i][part]);
+				if (result != VK_SUCCESS) {
+				 	PrintVkError(result);
+					throw std::runtime_error("failed to allocate dynamic command buffers!");
+				}
+			}
+		}
+	}
+
+	void recordCommandBuffer(uint32_t i) {
+		// Called when image i is no longer in flight: its command buffers can be reset
+		recordingThreads->parallelFor(dynamicCommandBuffersParts, [this, i](size_t part) {
+			vkResetCommandPool(device, dynamicCommandPools[i][part], 0);
+			beginSecondaryCommandBuffer(dynamicPartsCommandBuffers[i][part], i);
+			populateDynamicCommandBuffer(dynamicPartsCommandBuffers[i][part], i, part);
+			if (vkEndCommandBuffer(dynamicPartsCommandBuffers[i][part]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record dynamic command buffer!");
+			}
+		});
+
+		vkResetCommandBuffer(commandBuffers[i], 0);
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+
+		beginRenderPass(commandBuffers[i], i, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		std::vector<VkCommandBuffer> secondaryCommandBuffers = {staticCommandBuffers[i]};
+		secondaryCommandBuffers.insert(secondaryCommandBuffers.end(),
+				dynamicPartsCommandBuffers[i].begin(), dynamicPartsCommandBuffers[i].end());
+		vkCmdExecuteCommands(commandBuffers[i], static_cast<uint32_t>(secondaryCommandBuffers.size()),
+				secondaryCommandBuffers.data());
+		vkCmdEndRenderPass(commandBuffers[i]);
+
+		if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+	}
     
     void createSyncObjects() {
     	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
@@ -1644,6 +2039,9 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 		
 		updateUniformBuffer(imageIndex);
+		if (dynamicCommandBuffers) {
+			recordCommandBuffer(imageIndex);
+		}
 		
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1715,6 +2113,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		createDepthResources();
 		createFramebuffers();
 		createDescriptorPool();
+		uniformArena.init(this, uniformArenaRegionSize);
 
 		pipelinesAndDescriptorSetsInit();
 
@@ -1736,8 +2135,20 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		
 		vkFreeCommandBuffers(device, commandPool,
 				static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+		if (dynamicCommandBuffers) {
+			vkFreeCommandBuffers(device, commandPool,
+					static_cast<uint32_t>(staticCommandBuffers.size()), staticCommandBuffers.data());
+			for (std::vector<VkCommandPool> &imagePools : dynamicCommandPools) {
+				for (VkCommandPool pool : imagePools) {
+					vkDestroyCommandPool(device, pool, nullptr);
+				}
+			}
+			dynamicCommandPools.clear();
+			dynamicPartsCommandBuffers.clear();
+		}
 				
 		pipelinesAndDescriptorSetsCleanup();
+		uniformArena.cleanup();
 
 		vkDestroyRenderPass(device, renderPass, nullptr);
 
@@ -1762,6 +2173,8 @@ std::cout << "Starting createInstance()\n"  << std::flush;
     	}
     	
     	vkDestroyCommandPool(device, commandPool, nullptr);
+    	delete recordingThreads;
+    	delete assetThreads;
     	
  		vkDestroyDevice(device, nullptr);
 		
@@ -2466,6 +2879,18 @@ std::vector<VkVertexInputAttributeDescription> VertexDescriptor::getAttributeDes
 	return attributeDescriptions;
 }
 
+uint64_t VertexDescriptor::layoutHash() {
+	// Changes with anything that changes the bytes of the vertices
+	std::vector<uint32_t> layout = {MESH_CACHE_VERSION};
+	for(auto &B : Bindings) {
+		layout.insert(layout.end(), {B.binding, B.stride});
+	}
+	for(auto &E : Layout) {
+		layout.insert(layout.end(), {E.binding, E.location, (uint32_t)E.format, E.offset, E.size, (uint32_t)E.usage});
+	}
+	return MeshCache::hash((const uint8_t *)layout.data(), layout.size() * sizeof(uint32_t));
+}
+
 
 
 void Model::loadModelOBJ(std::string file) {
@@ -2485,9 +2910,13 @@ void Model::loadModelOBJ(std::string file) {
 //	std::cout << "UV " << VD->UV.hasIt << "," << VD->UV.offset << "\n";	
 //	std::cout << "Normal " << VD->Normal.hasIt << "," << VD->Normal.offset << "\n";
 	int mainStride = VD->Bindings[0].stride;
+	// Equal vertices (same position, normal, UV and color) are stored once
+	VertexWelder welder(vertices, mainStride);
+	std::vector<unsigned char> vertex(mainStride, 0);
+	size_t objVertices = 0;
 	for (const auto& shape : shapes) {
 		for (const auto& index : shape.mesh.indices) {
-			std::vector<unsigned char> vertex(mainStride, 0);
+			std::fill(vertex.begin(), vertex.end(), 0);
 			glm::vec3 pos = {
 				attrib.vertices[3 * index.vertex_index + 0],
 				attrib.vertices[3 * index.vertex_index + 1],
@@ -2527,12 +2956,20 @@ void Model::loadModelOBJ(std::string file) {
 				*o = norm;
 			}
 			
-			vertices.insert(vertices.end(), vertex.begin(), vertex.end());
-			indices.push_back((vertices.size()/mainStride)-1);
+			indices.push_back(welder.add(vertex.data()));
+			objVertices++;
 		}
 	}
-	std::cout << "[OBJ] Vertices: "<< (vertices.size()/mainStride);
-	std::cout << " Indices: "<< indices.size() << "\n";
+
+	// Triangles sorted for the post-transform vertex cache, vertices in the order they are used
+	uint32_t vertexCount = vertices.size() / mainStride;
+	float weldedACMR = MeshOptimizer::acmr(indices, vertexCount);
+	indices = MeshOptimizer::tipsify(indices, vertexCount);
+	MeshOptimizer::reorderVertices(vertices, mainStride, indices);
+
+	std::cout << "[OBJ] Vertices: "<< (vertices.size()/mainStride) << " (" << objVertices << " unwelded)";
+	std::cout << " Indices: "<< indices.size();
+	std::cout << " ACMR: 3 unwelded, " << weldedACMR << " welded, " << MeshOptimizer::acmr(indices, vertices.size() / mainStride) << " optimized\n";
 	
 }
 
@@ -2790,31 +3227,23 @@ std::cout << model.nodes[0].scale.size() << "\n";
 
 void Model::createVertexBuffer() {
 //	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-	VkDeviceSize bufferSize = vertices.size();
-
-	BP->createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-						VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-						vertexBuffer, vertexBufferMemory);
+	// A cached mesh is copied to the staging buffer straight from the mapped cache
+	bool cached = meshCacheFile.data() != nullptr;
+	VkDeviceSize bufferSize = cached ? meshCache.verticesSize : vertices.size();
 
-	void* data;
-	vkMapMemory(BP->device, vertexBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices.data(), (size_t) bufferSize);
-	vkUnmapMemory(BP->device, vertexBufferMemory);			
+	BP->createDeviceLocalBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+								cached ? (const void *)meshCache.vertices : vertices.data(),
+								vertexBuffer, vertexBufferMemory);
 }
 
 void Model::createIndexBuffer() {
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-	BP->createBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-							 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-							 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-							 indexBuffer, indexBufferMemory);
+	bool cached = meshCacheFile.data() != nullptr;
+	indexCount = cached ? meshCache.indexCount : static_cast<uint32_t>(indices.size());
+	VkDeviceSize bufferSize = sizeof(uint32_t) * indexCount;
 
-	void* data;
-	vkMapMemory(BP->device, indexBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t) bufferSize);
-	vkUnmapMemory(BP->device, indexBufferMemory);
+	BP->createDeviceLocalBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+								cached ? (const void *)meshCache.indices : indices.data(),
+								indexBuffer, indexBufferMemory);
 }
 
 void Model::initMesh(BaseProject *bp, VertexDescriptor *vd) {
@@ -2828,21 +3257,55 @@ void Model::initMesh(BaseProject *bp, VertexDescriptor *vd) {
 	Wm = glm::mat4(1);
 }
 
+void Model::loadMesh(std::string file, ModelType MT) {
+	// The loaded mesh is baked in a binary file next to the model (see MeshCache):
+	// while the model and the vertex layout do not change, it is mapped instead of parsing the model
+	std::string cacheFile = file + MESH_CACHE_EXTENSION;
+	uint64_t layoutHash = VD->layoutHash();
+	int mainStride = VD->Bindings[0].stride;
+	if(MeshCache::read(cacheFile, file, layoutHash, mainStride, meshCacheFile, meshCache)) {
+		std::cout << "Loading : " << file << "[cache] Vertices: " << (meshCache.verticesSize/mainStride)
+				  << " Indices: " << meshCache.indexCount << "\n";
+	} else {
+		meshCacheFile.close();
+		if(MT == OBJ) {
+			loadModelOBJ(file);
+		} else if(MT == GLTF) {
+			loadModelGLTF(file, false);
+		} else if(MT == MGCG) {
+			loadModelGLTF(file, true);
+		}
+		if(!MeshCache::write(cacheFile, file, layoutHash, mainStride, vertices, indices)) {
+			std::cout << "Can't write the mesh cache " << cacheFile << "\n";
+		}
+	}
+}
+
 void Model::init(BaseProject *bp, VertexDescriptor *vd, std::string file, ModelType MT) {
 	BP = bp;
 	VD = vd;
 	Wm = glm::mat4(1);
 
-	if(MT == OBJ) {
-		loadModelOBJ(file);
-	} else if(MT == GLTF) {
-		loadModelGLTF(file, false);
-	} else if(MT == MGCG) {
-		loadModelGLTF(file, true);
-	}
+	loadMesh(file, MT);
 	
 	createVertexBuffer();
 	createIndexBuffer();
+	meshCacheFile.close();
+}
+
+AssetHandle Model::initAsync(BaseProject *bp, VertexDescriptor *vd, std::string file, ModelType MT) {
+	// The model is parsed on the asset threads: it can't be used before the handle is ready
+	BP = bp;
+	VD = vd;
+	Wm = glm::mat4(1);
+
+	return BP->loadAsync([this, file, MT]() {
+		loadMesh(file, MT);
+	}, [this]() {
+		createVertexBuffer();
+		createIndexBuffer();
+		meshCacheFile.close();
+	});
 }
 
 void Model::cleanup() {
@@ -2867,10 +3330,39 @@ void Model::bind(VkCommandBuffer commandBuffer) {
 
 
 
-void Texture::createTextureImage(std::string files[], VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB) {
-	int texWidth, texHeight, texChannels;
+void Texture::loadPixels(std::string files[]) {
+	// A single image baked next to its source (same name, .ktx2) is loaded in its place, with its mip chain,
+	// as long as it was baked from the current content of the image (see Ktx2File::getSourceHash).
+	// Without BC the uncompressed version baked with a compressed one (.rgba8.ktx2) is loaded in its place,
+	// so the mip chain is never generated on the GPU for a baked texture
+	if(imgs == 1) {
+		std::string bakedPaths[2] = {Ktx2File::pathFor(files[0]), Ktx2File::fallbackPathFor(files[0])};
+		uint64_t sourceHash = 0;
+		for(const std::string &bakedPath : bakedPaths) {
+			if(!baked.open(bakedPath)) {
+				continue;
+			}
+			if(Ktx2File::isCompressed(baked.getFormat()) && !BP->textureCompressionBCSupported) {
+				baked.close();
+				continue;
+			}
+			if(sourceHash == 0) {
+				sourceHash = MeshCache::hashFile(files[0]);
+			}
+			if(baked.getSourceHash() != sourceHash) {
+				std::cout << "Outdated: " << bakedPath << " (bake it again)\n";
+				baked.close();
+				continue;
+			}
+			const Ktx2Level &level = baked.getLevels()[0];
+			std::cout << "[0]" << bakedPath << " -> size: " << level.width
+					  << "x" << level.height << ", levels: " << baked.getLevels().size() << "\n";
+			return;
+		}
+	}
+
+	int texChannels;
 	int curWidth = -1, curHeight = -1, curChannels = -1;
-	stbi_uc* pixels[maxImgs];
 	
 	for(int i = 0; i < imgs; i++) {
 	 	pixels[i] = stbi_load(files[i].c_str(), &texWidth, &texHeight,
@@ -2894,7 +3386,20 @@ void Texture::createTextureImage(std::string files[], VkFormat Fmt = VK_FORMAT_R
 			}
 		}
 	}
-	
+}
+
+void Texture::createTextureImage(std::string files[], VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB) {
+	loadPixels(files);
+	uploadTextureImage(Fmt);
+}
+
+void Texture::uploadTextureImage(VkFormat Fmt) {
+	if(!baked.getLevels().empty()) {
+		uploadBakedImage(Fmt);
+		return;
+	}
+	format = Fmt;
+
 	VkDeviceSize imageSize = texWidth * texHeight * 4;
 	VkDeviceSize totalImageSize = texWidth * texHeight * 4 * imgs;
 	mipLevels = static_cast<uint32_t>(std::floor(
@@ -2931,8 +3436,67 @@ void Texture::createTextureImage(std::string files[], VkFormat Fmt = VK_FORMAT_R
 	BP->generateMipmaps(textureImage, Fmt,
 					texWidth, texHeight, mipLevels, imgs);
 
-	vkDestroyBuffer(BP->device, stagingBuffer, nullptr);
-	vkFreeMemory(BP->device, stagingBufferMemory, nullptr);
+	BP->releaseStagingBuffer(stagingBuffer, stagingBufferMemory, totalImageSize);
+}
+
+VkFormat Texture::bakedFormat(VkFormat Fmt) {
+	// The blocks are the same in the sRGB and in the linear formats: Fmt tells how they are read
+	bool srgb = (Fmt == VK_FORMAT_R8G8B8A8_SRGB);
+	switch(baked.getFormat()) {
+		case KTX2_FORMAT_BC1_RGB_UNORM:
+		case KTX2_FORMAT_BC1_RGB_SRGB:
+			return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case KTX2_FORMAT_BC7_UNORM:
+		case KTX2_FORMAT_BC7_SRGB:
+			return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		default:
+			return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+void Texture::uploadBakedImage(VkFormat Fmt) {
+	const std::vector<Ktx2Level> &levels = baked.getLevels();
+	format = bakedFormat(Fmt);
+	texWidth = levels[0].width;
+	texHeight = levels[0].height;
+	mipLevels = static_cast<uint32_t>(levels.size());
+
+	// All the levels one after the other (their sizes are multiples of the block size)
+	std::vector<VkDeviceSize> levelOffsets;
+	VkDeviceSize totalImageSize = 0;
+	for(const Ktx2Level &level : levels) {
+		levelOffsets.push_back(totalImageSize);
+		totalImageSize += level.size;
+	}
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	 
+	BP->createBuffer(totalImageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	  						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+	  						VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	  						stagingBuffer, stagingBufferMemory);
+	void* data;
+	vkMapMemory(BP->device, stagingBufferMemory, 0, totalImageSize, 0, &data);
+	for(size_t i = 0; i < levels.size(); i++) {
+		memcpy(static_cast<char *>(data) + levelOffsets[i], levels[i].data, levels[i].size);
+	}
+	vkUnmapMemory(BP->device, stagingBufferMemory);
+	baked.close();
+
+	BP->createImage(texWidth, texHeight, mipLevels, 1, VK_SAMPLE_COUNT_1_BIT, format,
+				VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+				0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage,
+				textureImageMemory);
+
+	BP->transitionImageLayout(textureImage, format,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, 1);
+	BP->copyBufferToImageLevels(stagingBuffer, textureImage,
+			static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), levelOffsets);
+	BP->transitionImageLayout(textureImage, format,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels, 1);
+
+	BP->releaseStagingBuffer(stagingBuffer, stagingBufferMemory, totalImageSize);
 }
 
 void Texture::createTextureImageView(VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB) {
@@ -2987,18 +3551,34 @@ void Texture::init(BaseProject *bp, std::string file, VkFormat Fmt = VK_FORMAT_R
 	BP = bp;
 	imgs = 1;
 	createTextureImage(files, Fmt);
-	createTextureImageView(Fmt);
+	createTextureImageView(format);
 	if(initSampler) {
 		createTextureSampler();
 	}
 }
 
+AssetHandle Texture::initAsync(BaseProject *bp, std::string file, VkFormat Fmt = VK_FORMAT_R8G8B8A8_SRGB, bool initSampler = true) {
+	// The image is decoded on the asset threads: it can't be used before the handle is ready
+	BP = bp;
+	imgs = 1;
+	return BP->loadAsync([this, file]() {
+		std::string files[1] = {file};
+		loadPixels(files);
+	}, [this, Fmt, initSampler]() {
+		uploadTextureImage(Fmt);
+		createTextureImageView(format);
+		if(initSampler) {
+			createTextureSampler();
+		}
+	});
+}
+
 
 void Texture::initCubic(BaseProject *bp, std::string files[6]) {
 	BP = bp;
 	imgs = 6;
 	createTextureImage(files);
-	createTextureImageView();
+	createTextureImageView(format);
 	createTextureSampler();
 }
 
@@ -3267,7 +3847,9 @@ void DescriptorSetLayout::init(BaseProject *bp, std::vector<DescriptorSetLayoutB
 	binds.resize(B.size());
 	for(int i = 0; i < B.size(); i++) {
 		binds[i].binding = B[i].binding;
-		binds[i].descriptorType = B[i].type;
+		// Uniform blocks are sub-allocated in the uniform arena and bound with dynamic offsets
+		binds[i].descriptorType = B[i].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ?
+								  VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : B[i].type;
 		binds[i].descriptorCount = B[i].count;
 		binds[i].stageFlags = B[i].flags;
 		binds[i].pImmutableSamplers = nullptr;
@@ -3302,27 +3884,26 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 	int imgInfoSize = DSL->imgInfoSize;
 //std::cout << "imgInfoSize: " << imgInfoSize << "(" << size << ")\n";
 	
-	uniformBuffers.resize(size);
-	uniformBuffersMemory.resize(size);
-	toFree.resize(size);
+	uniformOffsets.resize(size);
+	dynamicBindings.clear();
 
 //std::cout << "Descriptor set init: " << E.size() << "\n";
 	for (int j = 0; j < size; j++) {
-		uniformBuffers[j].resize(BP->swapChainImages.size());
-		uniformBuffersMemory[j].resize(BP->swapChainImages.size());
 //std::cout << j << " " << E[j].type << "\n";
 		if(DSL->Bindings[j].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
-//std::cout << "Uniform size: " << E[j].size << "\n";
-			for (size_t i = 0; i < BP->swapChainImages.size(); i++) {
-				VkDeviceSize bufferSize = DSL->Bindings[j].linkSize;
-				BP->createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-									 	 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-									 	 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-									 	 uniformBuffers[j][i], uniformBuffersMemory[j][i]);
-			}
-			toFree[j] = true;
-		} else {
-			toFree[j] = false;
+			// The same offset in the region of every image of the uniform arena
+			uniformOffsets[j] = BP->uniformArena.allocate(DSL->Bindings[j].linkSize);
+			dynamicBindings.push_back(j);
+		}
+	}
+	// Dynamic offsets are given in the order of the binding numbers
+	std::sort(dynamicBindings.begin(), dynamicBindings.end(), [DSL](int a, int b) {
+		return DSL->Bindings[a].binding < DSL->Bindings[b].binding;
+	});
+	dynamicOffsets.assign(BP->swapChainImages.size(), std::vector<uint32_t>(dynamicBindings.size()));
+	for (size_t i = 0; i < BP->swapChainImages.size(); i++) {
+		for (size_t j = 0; j < dynamicBindings.size(); j++) {
+			dynamicOffsets[i][j] = BP->uniformArena.dynamicOffset(i, uniformOffsets[dynamicBindings[j]]);
 		}
 	}
 	
@@ -3349,15 +3930,15 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 		std::vector<VkDescriptorImageInfo> imageInfo(imgInfoSize);
 		for (int j = 0; j < size; j++) {
 			if(DSL->Bindings[j].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
-				bufferInfo[j].buffer = uniformBuffers[j][i];
-				bufferInfo[j].offset = 0;
+				bufferInfo[j].buffer = BP->uniformArena.buffer;
+				bufferInfo[j].offset = 0; // The offset is given when the set is bound
 				bufferInfo[j].range = DSL->Bindings[j].linkSize;
 				
 				descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 				descriptorWrites[j].dstSet = descriptorSets[i];
 				descriptorWrites[j].dstBinding = DSL->Bindings[j].binding;
 				descriptorWrites[j].dstArrayElement = 0;
-				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 				descriptorWrites[j].descriptorCount = DSL->Bindings[j].count;
 				descriptorWrites[j].pBufferInfo = &bufferInfo[j];
 			} else if(DSL->Bindings[j].type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
@@ -3386,14 +3967,7 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 }
 
 void DescriptorSet::cleanup() {
-	for(int j = 0; j < uniformBuffers.size(); j++) {
-		if(toFree[j]) {
-			for (size_t i = 0; i < BP->swapChainImages.size(); i++) {
-				vkDestroyBuffer(BP->device, uniformBuffers[j][i], nullptr);
-				vkFreeMemory(BP->device, uniformBuffersMemory[j][i], nullptr);
-			}
-		}
-	}
+	// Nothing of its own: the uniform blocks are in the uniform arena, the sets are freed with the pool
 }
 
 void DescriptorSet::bind(VkCommandBuffer commandBuffer, Pipeline &P, int setId,
@@ -3402,16 +3976,116 @@ void DescriptorSet::bind(VkCommandBuffer commandBuffer, Pipeline &P, int setId,
 	vkCmdBindDescriptorSets(commandBuffer,
 					VK_PIPELINE_BIND_POINT_GRAPHICS,
 					P.pipelineLayout, setId, 1, &descriptorSets[currentImage],
-					0, nullptr);
+					static_cast<uint32_t>(dynamicOffsets[currentImage].size()), dynamicOffsets[currentImage].data());
 }
 
 void DescriptorSet::map(int currentImage, void *src, int slot) {
-	void* data;
+	// The uniform arena is always mapped: just a copy
+	memcpy(BP->uniformArena.data(currentImage, uniformOffsets[slot]), src, Layout->Bindings[slot].linkSize);
+}
 
-	int size = Layout->Bindings[slot].linkSize;
+void UniformArena::init(BaseProject *bp, VkDeviceSize regionSize) {
+	// A single buffer, always mapped, with a region for each swap chain image: the uniform blocks
+	// of all the descriptor sets are sub-allocated in it once, when the sets are created, at the same
+	// offset in every region (a fixed slot for each block, not a per frame bump allocator).
+	// A frame writes only the region of its image, which the GPU is no longer reading
+	BP = bp;
+	
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(BP->physicalDevice, &physicalDeviceProperties);
+	alignment = physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+	this->regionSize = (regionSize + alignment - 1) / alignment * alignment;
+	regionsCount = BP->swapChainImages.size();
+	used = 0;
+
+	VkDeviceSize bufferSize = this->regionSize * regionsCount;
+	BP->createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+						 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+						 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+						 buffer, bufferMemory);
+	void *data;
+	VkResult result = vkMapMemory(BP->device, bufferMemory, 0, bufferSize, 0, &data);
+	if (result != VK_SUCCESS) {
+		PrintVkError(result);
+		throw std::runtime_error("failed to map uniform arena!");
+	}
+	mappedData = (uint8_t *)data;
+}
+
+void UniformArena::cleanup() {
+	vkUnmapMemory(BP->device, bufferMemory);
+	vkDestroyBuffer(BP->device, buffer, nullptr);
+	vkFreeMemory(BP->device, bufferMemory, nullptr);
+}
 
-	vkMapMemory(BP->device, uniformBuffersMemory[slot][currentImage], 0,
-						size, 0, &data);
-	memcpy(data, src, size);
-	vkUnmapMemory(BP->device, uniformBuffersMemory[slot][currentImage]);	
+VkDeviceSize UniformArena::allocate(VkDeviceSize size) {
+	VkDeviceSize offset = (used + alignment - 1) / alignment * alignment;
+	if (offset + size > regionSize) {
+		throw std::runtime_error("uniform arena region too small: increase uniformArenaRegionSize!");
+	}
+	used = offset + size;
+	return offset;
+}
+
+void *UniformArena::data(int currentImage, VkDeviceSize offset) {
+	return mappedData + currentImage * regionSize + offset;
+}
+
+uint32_t UniformArena::dynamicOffset(int currentImage, VkDeviceSize offset) {
+	return static_cast<uint32_t>(currentImage * regionSize + offset);
+}
+
+void IndirectBuffer::init(BaseProject *bp, int maxDraws) {
+	// One buffer of draw commands for each swap chain image, always mapped: the commands
+	// can be rewritten every frame without recording the command buffers again (but not how
+	// many of them are drawn, which is recorded by draw)
+	BP = bp;
+	this->maxDraws = maxDraws;
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(BP->physicalDevice, &physicalDeviceProperties);
+	maxDrawIndirectCount = BP->multiDrawIndirectSupported ? physicalDeviceProperties.limits.maxDrawIndirectCount : 1;
+	
+	buffers.resize(BP->swapChainImages.size());
+	buffersMemory.resize(BP->swapChainImages.size());
+	mappedCommands.resize(BP->swapChainImages.size());
+	for (size_t i = 0; i < BP->swapChainImages.size(); i++) {
+		VkDeviceSize bufferSize = sizeof(VkDrawIndexedIndirectCommand) * maxDraws;
+		BP->createBuffer(bufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+							 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+							 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+							 buffers[i], buffersMemory[i]);
+		void *data;
+		VkResult result = vkMapMemory(BP->device, buffersMemory[i], 0, bufferSize, 0, &data);
+		if (result != VK_SUCCESS) {
+			PrintVkError(result);
+			throw std::runtime_error("failed to map indirect buffer!");
+		}
+		mappedCommands[i] = (VkDrawIndexedIndirectCommand *)data;
+		memset(data, 0, (size_t) bufferSize);
+	}
+}
+
+void IndirectBuffer::cleanup() {
+	for (size_t i = 0; i < buffers.size(); i++) {
+		vkUnmapMemory(BP->device, buffersMemory[i]);
+		vkDestroyBuffer(BP->device, buffers[i], nullptr);
+		vkFreeMemory(BP->device, buffersMemory[i], nullptr);
+	}
+	buffers.clear();
+	buffersMemory.clear();
+	mappedCommands.clear();
+}
+
+VkDrawIndexedIndirectCommand *IndirectBuffer::commands(int currentImage) {
+	return mappedCommands[currentImage];
+}
+
+void IndirectBuffer::draw(VkCommandBuffer commandBuffer, int currentImage, int drawCount) {
+	// A call can read at most maxDrawIndirectCount commands (a single one without the multiDrawIndirect feature)
+	for (int first = 0; first < drawCount; first += maxDrawIndirectCount) {
+		uint32_t count = std::min((uint32_t)(drawCount - first), maxDrawIndirectCount);
+		vkCmdDrawIndexedIndirect(commandBuffer, buffers[currentImage],
+								 first * sizeof(VkDrawIndexedIndirectCommand), count,
+								 sizeof(VkDrawIndexedIndirectCommand));
+	}
 }
@@ -49,8 +49,10 @@ struct TextMaker {
 	Model M;
 	Texture T;
 	DescriptorSet DS;
+	IndirectBuffer Draw;	// The range of indices of the displayed text, one for each swap chain image
 	
 	std::vector<SingleText> *Texts;
+	int curText = 0;
 
 	void init(BaseProject *_BP, std::vector<SingleText> *_Texts) {
 		BP = _BP;
@@ -212,11 +214,24 @@ struct TextMaker {
 	void pipelinesAndDescriptorSetsInit() {
 		P.create();
 		createTextDescriptorSets();
+		Draw.init(BP, 1);
+		for(int i = 0; i < Draw.buffers.size(); i++) {
+			setText(i, curText);
+		}
 	}
 	
 	void pipelinesAndDescriptorSetsCleanup() {
 		P.cleanup();
 		DS.cleanup();
+		Draw.cleanup();
+	}
+
+	// Changes the displayed text without recording the command buffers again:
+	// only the draw command of the image is rewritten
+	void setText(int currentImage, int _curText) {
+		curText = _curText;
+		*Draw.commands(currentImage) = {static_cast<uint32_t>((*Texts)[curText].len), 1,
+										static_cast<uint32_t>((*Texts)[curText].start), 0, 0};
 	}
 
 	void localCleanup() {
@@ -227,13 +242,12 @@ struct TextMaker {
 		P.destroy();
 	}
 	
-    void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage, int curText = 0) {
+    void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage) {
     	P.bind(commandBuffer);
 		M.bind(commandBuffer);
 		DS.bind(commandBuffer, P, 0, currentImage);
 		
-		vkCmdDrawIndexed(commandBuffer,
-						static_cast<uint32_t>((*Texts)[curText].len), 1, static_cast<uint32_t>((*Texts)[curText].start), 0, 0);
+		Draw.draw(commandBuffer, currentImage, 1); // The text is chosen with setText
 			
 	}
 };
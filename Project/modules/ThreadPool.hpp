@@ -0,0 +1,218 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <exception>
+
+class ThreadPool
+{
+  /**
+   * Work-stealing thread pool.
+   * Every worker owns a queue of tasks: it runs its own tasks starting from the most recent one
+   * (still hot in cache) and, when its queue is empty, it steals the oldest task of another worker.
+   * Tasks submitted from outside the pool are spread round robin among the queues, tasks submitted
+   * by a worker go to its own queue.
+   * parallelFor can be called by a task (nested loops): the worker runs the pending tasks while it waits,
+   * instead of blocking a thread that the loop may need.
+   */
+public:
+  ThreadPool(unsigned int threadsNumber = std::thread::hardware_concurrency())
+  {
+    if (threadsNumber == 0)
+      threadsNumber = 1;
+    for (unsigned int i = 0; i < threadsNumber; i++)
+      queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    for (unsigned int i = 0; i < threadsNumber; i++)
+      workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+  unsigned int getThreadsNumber() const
+  {
+    return workers.size();
+  }
+
+  void submit(std::function<void()> task)
+  {
+    size_t queueIndex = currentPool == this ? currentWorker : nextQueue++ % queues.size();
+    pendingTasks++;
+    {
+      std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+      queues[queueIndex]->tasks.push_back(std::move(task));
+    }
+    {
+      // Counted under the state mutex, so a worker can't miss it between its check and its wait
+      std::lock_guard<std::mutex> lock(stateMutex);
+      queuedTasks++;
+    }
+    taskAvailable.notify_one();
+  }
+
+  void waitIdle()
+  {
+    // Wait until all the submitted tasks are completed (not to be called by a task).
+    // If a task threw an exception, the first one is thrown here.
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allTasksDone.wait(lock, [this]
+                      { return pendingTasks == 0; });
+    if (taskException)
+    {
+      std::exception_ptr exception = taskException;
+      taskException = nullptr;
+      std::rethrow_exception(exception);
+    }
+  }
+
+  void parallelFor(size_t count, const std::function<void(size_t)> &body)
+  {
+    // Run body(0) ... body(count - 1) on the pool and wait for them (but not for the other tasks).
+    // Called by a worker of the pool, the worker takes part in the loop
+    std::mutex doneMutex;
+    std::condition_variable done;
+    size_t remaining = count;
+    std::exception_ptr exception;
+    for (size_t i = 0; i < count; i++)
+    {
+      submit([&, i]
+             {
+               std::exception_ptr bodyException;
+               try
+               {
+                 body(i);
+               }
+               catch (...)
+               {
+                 bodyException = std::current_exception();
+               }
+               std::lock_guard<std::mutex> lock(doneMutex);
+               if (bodyException && !exception)
+                 exception = bodyException;
+               if (--remaining == 0)
+                 done.notify_all(); });
+    }
+    if (currentPool == this)
+    {
+      // Waiting would block a worker: with all the workers in nested loops no one would be left to run the
+      // bodies. The own bodies are the newest tasks of the own queue, taken first
+      std::function<void()> task;
+      while (takeTask(currentWorker, task))
+      {
+        runTask(task);
+        std::lock_guard<std::mutex> lock(doneMutex);
+        if (remaining == 0)
+          break;
+      }
+    }
+    // When nothing is left in the queues, the remaining bodies are running on other threads
+    std::unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [&]
+              { return remaining == 0; });
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+
+private:
+  struct WorkerQueue
+  {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::vector<std::thread> workers;
+  std::mutex stateMutex;
+  std::condition_variable taskAvailable;
+  std::condition_variable allTasksDone;
+  std::atomic<size_t> queuedTasks{0};  // In a queue, not yet taken by a worker
+  std::atomic<size_t> pendingTasks{0}; // Submitted and not completed
+  std::atomic<size_t> nextQueue{0};
+  std::exception_ptr taskException;
+  bool stopping = false;
+
+  // Set on the worker threads, used to submit to the own queue
+  static inline thread_local ThreadPool *currentPool = nullptr;
+  static inline thread_local size_t currentWorker = 0;
+
+  bool takeTask(size_t workerIndex, std::function<void()> &task)
+  {
+    // Newest task of the own queue first, otherwise the oldest task of the other queues
+    {
+      WorkerQueue &queue = *queues[workerIndex];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty())
+      {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        queuedTasks--;
+        return true;
+      }
+    }
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+      WorkerQueue &queue = *queues[(workerIndex + i) % queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty())
+      {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        queuedTasks--;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void runTask(std::function<void()> &task)
+  {
+    try
+    {
+      task();
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      if (!taskException)
+        taskException = std::current_exception();
+    }
+    if (--pendingTasks == 0)
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      allTasksDone.notify_all();
+    }
+  }
+
+  void workerLoop(size_t workerIndex)
+  {
+    currentPool = this;
+    currentWorker = workerIndex;
+    while (true)
+    {
+      std::function<void()> task;
+      if (takeTask(workerIndex, task))
+      {
+        runTask(task);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(stateMutex);
+      taskAvailable.wait(lock, [this]
+                         { return stopping || queuedTasks > 0; });
+      if (stopping && queuedTasks == 0)
+        return;
+    }
+  }
+};
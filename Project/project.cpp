@@ -2,6 +2,9 @@
 #include "modules/MazeGenerator.hpp"
 #include "modules/TextMaker.hpp"
 #include "modules/GameObjects.hpp"
+#include "modules/MazeMesher.hpp"
+#include "modules/Frustum.hpp"
+#include "modules/MazeVisibility.hpp"
 
 #define UNITARY_SCALE 3.0f
 #define UV_PAVEMENT_SCALE 16.0f
@@ -9,6 +12,8 @@
 #define PLATFORM_NUMBER 2
 #define INITIAL_PLAYER_HEIGHT 2.0f
 #define CENTRE_PAV_Z 23.97f
+#define MAZE_SEED 8
+#define VIEW_DISTANCE 50.0f // Far plane, nothing farther is drawn
 
 std::vector<SingleText> demoText;
 
@@ -22,13 +27,6 @@ struct UniformBufferObject
 	alignas(16) glm::mat4 nMat;
 };
 
-struct MazeUniformBufferObject
-{
-	alignas(16) glm::mat4 mvpMat[MAZE_SIZE][MAZE_SIZE][MAZE_HEIGHT];
-	alignas(16) glm::mat4 mMat[MAZE_SIZE][MAZE_SIZE][MAZE_HEIGHT];
-	alignas(16) glm::mat4 nMat[MAZE_SIZE][MAZE_SIZE][MAZE_HEIGHT];
-};
-
 struct LampUniformBufferObject
 {
 
@@ -78,6 +76,9 @@ struct GlobalUniformBufferObject
 	alignas(4) float cupLightDecayFactor;
 	alignas(4) float cupCIN;
 	alignas(4) float cupCOUT;
+
+	// camera, for the shaders that compute the clipping coordinates themselves
+	alignas(16) glm::mat4 viewPrj;
 };
 
 struct PavementParametersUniformBufferObject
@@ -107,10 +108,18 @@ struct Vertex
 class Project : public BaseProject
 {
 public:
-	Project()
+	Project(const char *mazeFile = nullptr)
 	{
-		maze = new Maze();
-		maze->generateMaze();
+		maze = new Maze(MAZE_SEED);
+		if (mazeFile != nullptr)
+		{
+			// Pre-baked maze (see Maze::saveMaze): no generation needed
+			maze->loadMaze(mazeFile);
+			if (maze->getWidth() != MAZE_SIZE || maze->getHeight() != MAZE_SIZE)
+				throw std::runtime_error("the maze file must contain a " + std::to_string(MAZE_SIZE) + "x" + std::to_string(MAZE_SIZE) + " maze");
+		}
+		else
+			maze->generateMaze();
 		player.setPosition(glm::vec3(maze->getStartPoint().c * UNITARY_SCALE, INITIAL_PLAYER_HEIGHT, maze->getStartPoint().r * UNITARY_SCALE));
 		player.setRotation(glm::vec2(glm::radians(180.0f), -0.3f));
 	}
@@ -137,9 +146,15 @@ protected:
 	Texture TPavDif, TPavSpec;
 	DescriptorSet DSPavement, DSG; // Even if we have just one object, since we have two DSL, we also need two sets.
 
-	Model MBox;
+	Model MMaze; // All the walls in a single mesh, see MazeMesher
 	Texture TCubeDiffuse, TCubeSpecular, TCubeAmbient;
 	DescriptorSet DSBox;
+	std::vector<MazeMeshChunk> mazeChunks;
+	std::vector<int> mazeChunksGrid; // Index in mazeChunks of each chunk of cells (-1 if it has no walls)
+	IndirectBuffer mazeDraws;		 // The draws of the chunks in sight first, see updateUniformBuffer
+	std::vector<bool> mazeChunkDrawn;		 // Chunks already among the draws of the frame
+	std::vector<uint32_t> drawnMazeChunks; // The chunks with mazeChunkDrawn set
+	int mazeDrawCount = 0;				 // Draws of the next frame
 
 	Model MPlatform;
 	Texture TPlatDiffuse, TPlatSpecular;
@@ -169,7 +184,6 @@ protected:
 	bool uniformBuffersInit = false; // Run update of static objects only once
 	GlobalUniformBufferObject gubo{};
 	UniformBufferObject pavUbo{};
-	MazeUniformBufferObject mazeUbo;
 	PlatformUniformBufferObject platUbo{};
 	LampUniformBufferObject lampUbo{};
 	PavementParametersUniformBufferObject pavparubo{};
@@ -182,14 +196,39 @@ protected:
 	// GameObjects
 	Maze* maze;
 	Player player = Player(UNITARY_SCALE);
+	MazeVisibility mazeVisibility;
 
 	//Display text
 	int currText = 0;
 
+	// Props drawn in the next frame: not taken and not hidden by the walls
+	bool lampDrawn[WALL_LIGHTS_NUMBER] = {};
+	bool keyDrawn[KEYS_NUMBER] = {};
+
 	// Other application parameters
 	// Current aspect ratio, used to build a correct Projection matrix
 	float Ar;
 
+	// The maze walls are static: they are meshed once, in world coordinates
+	void initMazeMesh()
+	{
+		MazeMesh mesh = MazeMesher(UNITARY_SCALE, MAZE_HEIGHT).build(maze->getMazeView());
+		MMaze.vertices.resize(mesh.vertices.size() * sizeof(Vertex));
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			Vertex vertex = {mesh.vertices[i].pos, mesh.vertices[i].norm, mesh.vertices[i].UV};
+			memcpy(&MMaze.vertices[i * sizeof(Vertex)], &vertex, sizeof(Vertex));
+		}
+		MMaze.indices = mesh.indices;
+		MMaze.initMesh(this, &VD);
+		mazeChunks = mesh.chunks;
+		int chunksColumns = (maze->getWidth() + MAZE_MESH_CHUNK_SIZE - 1) / MAZE_MESH_CHUNK_SIZE;
+		mazeChunksGrid.assign(chunksColumns * ((maze->getHeight() + MAZE_MESH_CHUNK_SIZE - 1) / MAZE_MESH_CHUNK_SIZE), -1);
+		for (size_t i = 0; i < mazeChunks.size(); i++)
+			mazeChunksGrid[(mazeChunks[i].firstCell.r / MAZE_MESH_CHUNK_SIZE) * chunksColumns + mazeChunks[i].firstCell.c / MAZE_MESH_CHUNK_SIZE] = i;
+		std::cout << "Maze mesh: " << mesh.indices.size() / 3 << " triangles for " << mesh.wallBlocks << " wall blocks, " << mazeChunks.size() << " chunks\n";
+	}
+
 	// Here you set the window parameters
 	void setWindowParameters()
 	{
@@ -200,6 +239,10 @@ protected:
 		windowResizable = GLFW_TRUE;
 		initialBackgroundColor = {0.02f, 0.1f, 0.4f, 1.0f};
 
+		// The props and the maze chunks in sight change at each frame: record them again every time (see populateDynamicCommandBuffer)
+		dynamicCommandBuffers = true;
+		dynamicCommandBuffersParts = DYNAMIC_PARTS_NUMBER;
+
 		// The initial aspect rati of the window. In this code, we assume square pixels
 		Ar = 4.0f / 3.0f;
 	}
@@ -232,8 +275,8 @@ protected:
 
 							   });
 
-		DSLBox.init(this, {{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, sizeof(MazeUniformBufferObject), 1},
-						   {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0, 1},
+		// The maze mesh is in world coordinates: only the view-projection matrix of the global set is needed to draw it
+		DSLBox.init(this, {{1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0, 1},
 						   {2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, 1},
 						   {3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2, 1},
 						   {4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(BoxParametersUniformBufferObject), 1}});
@@ -345,59 +388,61 @@ protected:
 		// The second parameter is the pointer to the vertex definition for this model
 		// The third parameter is the file name
 		// The last is a constant specifying the file type: currently only OBJ, GLTF or the custom type MGCG
+		// initAsync parses the models and decodes the textures on the asset threads while this goes on:
+		// they are all uploaded, in a single batch, at the end of localInit
 
 		// Pavement Model
-		MPavement.init(this, &VD, "models/Pavement.obj", OBJ);
+		MPavement.initAsync(this, &VD, "models/Pavement.obj", OBJ);
 
-		// Box model
-		MBox.init(this, &VD, "models/Cube.obj", OBJ);
+		// Maze model
+		initMazeMesh();
 
-		MPlatform.init(this, &VD, "models/platform.obj", OBJ);
+		MPlatform.initAsync(this, &VD, "models/platform.obj", OBJ);
 
-		MLamp.init(this, &VD, "models/Lamp.obj", OBJ);
+		MLamp.initAsync(this, &VD, "models/Lamp.obj", OBJ);
 
-		MOilLamp.init(this, &VD, "models/Oil_lamp.obj", OBJ);
+		MOilLamp.initAsync(this, &VD, "models/Oil_lamp.obj", OBJ);
 
-		MCup.init(this, &VD, "models/Cup.obj", OBJ);
+		MCup.initAsync(this, &VD, "models/Cup.obj", OBJ);
 
-		MKey.init(this, &VD, "models/Key.obj", OBJ);
+		MKey.initAsync(this, &VD, "models/Key.obj", OBJ);
 
-		MMoon.init(this, &VD, "models/Moon.obj", OBJ);
+		MMoon.initAsync(this, &VD, "models/Moon.obj", OBJ);
 
 		// Create the textures
 		// The second parameter is the file name containing the image
 
 		// Pavement Textures
-		TPavDif.init(this, "textures/TPavDif.jpg");
-		TPavSpec.init(this, "textures/TPavSpec.jpg");
+		TPavDif.initAsync(this, "textures/TPavDif.jpg");
+		TPavSpec.initAsync(this, "textures/TPavSpec.jpg");
 		// Box Textures
-		TCubeDiffuse.init(this, "textures/Cube_diffuse.jpg");
-		TCubeSpecular.init(this, "textures/Cube_specular.jpg");
-		TCubeAmbient.init(this, "textures/Cube_ambient.jpg");
+		TCubeDiffuse.initAsync(this, "textures/Cube_diffuse.jpg");
+		TCubeSpecular.initAsync(this, "textures/Cube_specular.jpg");
+		TCubeAmbient.initAsync(this, "textures/Cube_ambient.jpg");
 
 		// plat textures
-		TPlatDiffuse.init(this, "textures/platformBase.png");
-		TPlatSpecular.init(this, "textures/platformSpec.png");
+		TPlatDiffuse.initAsync(this, "textures/platformBase.png");
+		TPlatSpecular.initAsync(this, "textures/platformSpec.png");
 
 		// Lamp texture
-		TLampDiffuse.init(this, "textures/lanternDiffuse.png");
-		TLampSpecular.init(this, "textures/lanternSpecular.png");
+		TLampDiffuse.initAsync(this, "textures/lanternDiffuse.png");
+		TLampSpecular.initAsync(this, "textures/lanternSpecular.png");
 
-		TOilLampDiffuse.init(this, "textures/Oil_lamp_Diffuse.png");
-		TOilLampSpecular.init(this, "textures/Oil_lamp_Specular.png");
+		TOilLampDiffuse.initAsync(this, "textures/Oil_lamp_Diffuse.png");
+		TOilLampSpecular.initAsync(this, "textures/Oil_lamp_Specular.png");
 
-		TCupDiffuse.init(this, "textures/Cup_diffuse2.png");
-		TCupSpecular.init(this, "textures/Cup_specular.png");
+		TCupDiffuse.initAsync(this, "textures/Cup_diffuse2.png");
+		TCupSpecular.initAsync(this, "textures/Cup_specular.png");
 
-		TKeyDiffuse.init(this, "textures/KeyDiffuse.jpg");
-		TKeySpecular.init(this, "textures/KeySpecular.jpg");
+		TKeyDiffuse.initAsync(this, "textures/KeyDiffuse.jpg");
+		TKeySpecular.initAsync(this, "textures/KeySpecular.jpg");
 
-		TMoonDiffuse.init(this, "textures/MoonDiffuse.png");
+		TMoonDiffuse.initAsync(this, "textures/MoonDiffuse.png");
 
 		// MODIFY POOL SIZE
 
 		// Descriptor pool sizes
-		DPSZs.uniformBlocksInPool = 11; // Uniform blocks: Ubo, Gubo, PavParUbo
+		DPSZs.uniformBlocksInPool = 10; // Uniform blocks: Ubo, Gubo, PavParUbo
 		DPSZs.texturesInPool = 16;		// Pavement: 3, Box: 4
 		DPSZs.setsInPool = 9;			// Global set (0), Pavement set (1 in PPavement), Box set (1 in PBox)
 
@@ -435,6 +480,9 @@ protected:
 		DSMoon.init(this, &DSLMoon, {&TMoonDiffuse});
 
 		DSG.init(this, &DSLG, {}); // note that if a DSL has no texture, the array can be empty
+
+		mazeDraws.init(this, mazeChunks.size());
+		mazeChunkDrawn.assign(mazeChunks.size(), false);
 	}
 
 	// Here you destroy your pipelines and Descriptor Sets!
@@ -460,6 +508,8 @@ protected:
 		DSKey.cleanup();
 		DSMoon.cleanup();
 		DSG.cleanup();
+
+		mazeDraws.cleanup();
 	}
 
 	// Here you destroy all the Models, Texture and Desc. Set Layouts you created!
@@ -473,7 +523,7 @@ protected:
 		TCubeDiffuse.cleanup();
 		TCubeSpecular.cleanup();
 		TCubeAmbient.cleanup();
-		MBox.cleanup();
+		MMaze.cleanup();
 
 		TPlatDiffuse.cleanup();
 		TPlatSpecular.cleanup();
@@ -519,10 +569,20 @@ protected:
 		PMoon.destroy();
 	}
 
+	// The parts of the scene that change from frame to frame, recorded again at each frame in parallel
+	enum DynamicPart
+	{
+		MAZE_PART,
+		LAMPS_PART,
+		KEYS_PART,
+		DYNAMIC_PARTS_NUMBER
+	};
+
 	// Here it is the creation of the command buffer:
 	// You send to the GPU all the objects you want to draw,
-	// with their buffers and textures
-	void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage)
+	// with their buffers and textures.
+	// The static part of the scene is recorded only once, when the swap chain is created
+	void populateStaticCommandBuffer(VkCommandBuffer commandBuffer, int currentImage)
 	{
 		// The resources that needs to be bound for drawing something, are:
 
@@ -534,63 +594,79 @@ protected:
 		// For this reason, the second parameter refers to the corresponding pipeline
 		// And the third is the Set number to which the descriptor set should be bound
 
-		txt.populateCommandBuffer(commandBuffer, currentImage, currText);
+		txt.populateCommandBuffer(commandBuffer, currentImage); // The text is chosen by updateUniformBuffer
 
 		PPavement.bind(commandBuffer);
 		MPavement.bind(commandBuffer);
 		DSG.bind(commandBuffer, PPavement, 0, currentImage);		// The Global Descriptor Set (Set 0)
 		DSPavement.bind(commandBuffer, PPavement, 1, currentImage); // The Material and Position Descriptor Set (Set 1)
 		vkCmdDrawIndexed(commandBuffer,
-						 static_cast<uint32_t>(MPavement.indices.size()), 1, 0, 0, 0);
-
-		PBox.bind(commandBuffer);
-		MBox.bind(commandBuffer);
-		DSG.bind(commandBuffer, PBox, 0, currentImage);	  // The Global Descriptor Set (Set 0)
-		DSBox.bind(commandBuffer, PBox, 1, currentImage); // Again in set 1 since it's another pipeline
-		vkCmdDrawIndexed(commandBuffer,
-						 static_cast<uint32_t>(MBox.indices.size()), MAZE_SIZE * MAZE_SIZE * MAZE_HEIGHT, 0, 0, 0);
+						 MPavement.indexCount, 1, 0, 0, 0);
 
 		PPlatform.bind(commandBuffer);
 		MPlatform.bind(commandBuffer);
 		DSG.bind(commandBuffer, PPlatform, 0, currentImage);
 		DSPlatform.bind(commandBuffer, PPlatform, 1, currentImage);
 		vkCmdDrawIndexed(commandBuffer,
-						 static_cast<uint32_t>(MPlatform.indices.size()), PLATFORM_NUMBER, 0, 0, 0);
-
-		PLamp.bind(commandBuffer);
-		MLamp.bind(commandBuffer);
-		DSG.bind(commandBuffer, PLamp, 0, currentImage);
-		DSLamp.bind(commandBuffer, PLamp, 1, currentImage);
-		vkCmdDrawIndexed(commandBuffer,
-						 static_cast<uint32_t>(MLamp.indices.size()), WALL_LIGHTS_NUMBER, 0, 0, 0);
+						 MPlatform.indexCount, PLATFORM_NUMBER, 0, 0, 0);
 
 		POilLamp.bind(commandBuffer);
 		MOilLamp.bind(commandBuffer);
 		DSG.bind(commandBuffer, POilLamp, 0, currentImage);
 		DSOilLamp.bind(commandBuffer, POilLamp, 1, currentImage);
 		vkCmdDrawIndexed(commandBuffer,
-						 static_cast<uint32_t>(MOilLamp.indices.size()), 1, 0, 0, 0);
+						 MOilLamp.indexCount, 1, 0, 0, 0);
 
 		PCup.bind(commandBuffer);
 		MCup.bind(commandBuffer);
 		DSG.bind(commandBuffer, PCup, 0, currentImage);
 		DSCup.bind(commandBuffer, PCup, 1, currentImage);
 		vkCmdDrawIndexed(commandBuffer,
-						 static_cast<uint32_t>(MCup.indices.size()), 1, 0, 0, 0);
-
-		PKey.bind(commandBuffer);
-		MKey.bind(commandBuffer);
-		DSG.bind(commandBuffer, PKey, 0, currentImage);
-		DSKey.bind(commandBuffer, PKey, 1, currentImage);
-		vkCmdDrawIndexed(commandBuffer,
-						 static_cast<uint32_t>(MKey.indices.size()), KEYS_NUMBER, 0, 0, 0);
+						 MCup.indexCount, 1, 0, 0, 0);
 
 		PMoon.bind(commandBuffer);
 		MMoon.bind(commandBuffer);
 		DSG.bind(commandBuffer, PMoon, 0, currentImage);
 		DSMoon.bind(commandBuffer, PMoon, 1, currentImage);
 		vkCmdDrawIndexed(commandBuffer,
-						 static_cast<uint32_t>(MMoon.indices.size()), 1, 0, 0, 0);
+						 MMoon.indexCount, 1, 0, 0, 0);
+	}
+
+	// The dynamic parts are recorded after updateUniformBuffer, on different threads: only read the state here
+	void populateDynamicCommandBuffer(VkCommandBuffer commandBuffer, int currentImage, int part)
+	{
+		switch (part)
+		{
+		case MAZE_PART:
+			// Only the chunks in sight, their draws are the first mazeDrawCount commands
+			PBox.bind(commandBuffer);
+			MMaze.bind(commandBuffer);
+			DSG.bind(commandBuffer, PBox, 0, currentImage);	  // The Global Descriptor Set (Set 0)
+			DSBox.bind(commandBuffer, PBox, 1, currentImage); // Again in set 1 since it's another pipeline
+			mazeDraws.draw(commandBuffer, currentImage, mazeDrawCount);
+			break;
+		case LAMPS_PART:
+			// Only the lamps in sight, the instance index selects the uniforms of the lamp
+			PLamp.bind(commandBuffer);
+			MLamp.bind(commandBuffer);
+			DSG.bind(commandBuffer, PLamp, 0, currentImage);
+			DSLamp.bind(commandBuffer, PLamp, 1, currentImage);
+			for (int l = 0; l < WALL_LIGHTS_NUMBER; l++)
+				if (lampDrawn[l])
+					vkCmdDrawIndexed(commandBuffer,
+									 MLamp.indexCount, 1, 0, 0, l);
+			break;
+		case KEYS_PART:
+			PKey.bind(commandBuffer);
+			MKey.bind(commandBuffer);
+			DSG.bind(commandBuffer, PKey, 0, currentImage);
+			DSKey.bind(commandBuffer, PKey, 1, currentImage);
+			for (int k = 0; k < KEYS_NUMBER; k++)
+				if (keyDrawn[k])
+					vkCmdDrawIndexed(commandBuffer,
+									 MKey.indexCount, 1, 0, 0, k);
+			break;
+		}
 	}
 
 	// Here is where you update the uniforms.
@@ -614,13 +690,23 @@ protected:
 
 
 		// Camera LookIn view
-		glm::mat4 M = glm::perspective(glm::radians(45.0f), Ar, 0.1f, 50.0f);
+		glm::mat4 M = glm::perspective(glm::radians(45.0f), Ar, 0.1f, VIEW_DISTANCE);
 		M[1][1] *= -1;
 		glm::mat4 Mv = glm::rotate(glm::mat4(1.0), -player.getRotation().y, glm::vec3(1, 0, 0)) *
 					   glm::rotate(glm::mat4(1.0), -player.getRotation().x, glm::vec3(0, 1, 0)) *
 					   glm::translate(glm::mat4(1.0), -player.getPosition());
 		glm::mat4 ViewPrj = M * Mv;
 
+		// Farthest distance in sight: the corners of the far plane are farther than its center
+		float viewRange = 0.0f;
+		glm::mat4 invViewPrj = glm::inverse(ViewPrj);
+		for (float x : {-1.0f, 1.0f})
+			for (float y : {-1.0f, 1.0f})
+			{
+				glm::vec4 corner = invViewPrj * glm::vec4(x, y, 1.0f, 1.0f);
+				viewRange = glm::max(viewRange, glm::distance(glm::vec3(corner) / corner.w, player.getPosition()));
+			}
+
 		// |||||| Global uniforms |||||||
 
 		// hand lantern
@@ -666,10 +752,14 @@ protected:
 		platUbo.ubo[0].mvpMat = ViewPrj * platUbo.ubo[0].mMat;
 		platUbo.ubo[1].mvpMat = ViewPrj * platUbo.ubo[1].mMat;
 
+		// Cells in sight of the player, the walls hiding the rest of the maze (false out of the maze)
+		bool insideMaze = mazeVisibility.update(maze->getMazeView(), player.getPosition().x / UNITARY_SCALE, player.getPosition().z / UNITARY_SCALE,
+												viewRange / UNITARY_SCALE);
+
 		// Keys uniforms
 		int i = 0;
 		int temp = 0;
-		for (Key key : *maze->getMazeKeys())
+		for (const Key &key : maze->getMazeKeys())
 		{
 			if (!key.isTaken)
 				keyUbo.ubo[i].mMat = glm::translate(glm::mat4(1.0f), glm::vec3(key.point.c * UNITARY_SCALE, 0.4, key.point.r * UNITARY_SCALE));
@@ -679,17 +769,17 @@ protected:
 			}
 			keyUbo.ubo[i].nMat = glm::inverse(glm::transpose(keyUbo.ubo[i].mMat));
 			keyUbo.ubo[i].mvpMat = ViewPrj * keyUbo.ubo[i].mMat;
+			keyDrawn[i] = !key.isTaken && (!insideMaze || mazeVisibility.isVisible(key.point.r, key.point.c));
 			i++;
 		}
 
 		//Set the text to display
 		if(temp != currText && currText<=KEYS_NUMBER){
 			currText = temp;
-			RebuildPipeline();
 		}else if(player.isTeleported()&&currText!=KEYS_NUMBER+1){
 			currText = KEYS_NUMBER + 1;
-			RebuildPipeline();
 		}	
+		txt.setText(currentImage, currText);
 		
 
 		if (uniformBuffersInit == false)
@@ -735,7 +825,7 @@ protected:
 		}
 
 		int l = 0;
-		for (Light light : maze->getMazeLights())
+		for (const Light &light : maze->getMazeLights())
 		{
 			if (uniformBuffersInit == false)
 			{
@@ -772,6 +862,7 @@ protected:
 				lampUbo.ubo[l].nMat = glm::inverse(glm::transpose(lampUbo.ubo[l].mMat));
 			}
 			lampUbo.ubo[l].mvpMat = ViewPrj * lampUbo.ubo[l].mMat;
+			lampDrawn[l] = !insideMaze || mazeVisibility.isVisible(light.point.r, light.point.c);
 			l++;
 		}
 
@@ -779,30 +870,47 @@ protected:
 		// gubo.wallLampPos[1] = glm::vec4(9.0f, 6.5f, 9.0f, 0.0f);
 		// gubo.wallLampPos[2] = glm::vec4(19.0f, 6.5f, 19.0f, 0.0f);
 
-		int row, col, h;
-		for (row = 0; row < MAZE_SIZE; row++)
+		gubo.viewPrj = ViewPrj;
+
+		// Maze culling: inside the maze only the chunks with a cell in sight of the player (see MazeVisibility)
+		// and in the view frustum are drawn. Their draws are packed at the start of the commands and only those
+		// are recorded, so the work depends on what is visible and not on the maze size
+		Frustum frustum(ViewPrj);
+		VkDrawIndexedIndirectCommand *mazeCommands = mazeDraws.commands(currentImage);
+		mazeDrawCount = 0;
+		auto drawMazeChunk = [&](uint32_t i)
 		{
-			for (col = 0; col < MAZE_SIZE; col++)
+			if (mazeChunkDrawn[i])
+				return;
+			mazeChunkDrawn[i] = true;
+			drawnMazeChunks.push_back(i);
+			const MazeMeshChunk &chunk = mazeChunks[i];
+			if (frustum.intersects(chunk.boundsMin, chunk.boundsMax))
+				mazeCommands[mazeDrawCount++] = {chunk.indexCount, 1, chunk.firstIndex, 0, 0};
+		};
+		if (insideMaze)
+		{
+			int chunksColumns = (maze->getWidth() + MAZE_MESH_CHUNK_SIZE - 1) / MAZE_MESH_CHUNK_SIZE;
+			for (const MazePoint &cell : mazeVisibility.getVisibleCells())
 			{
-				for (h = 0; h < MAZE_HEIGHT; h++)
-				{
-					if (uniformBuffersInit == false)
-					{
-						// Maze placement in uniforms is done just once
-						if (maze->getMazeMap()[row][col] == MazeWay::WALL)
-						{
-							mazeUbo.mMat[row][col][h] = glm::translate(glm::mat4(1.0f), glm::vec3(UNITARY_SCALE * (float)(col), UNITARY_SCALE * (float)h + (row == 0 && col == 0 ? 1.0f : 0.0f), UNITARY_SCALE * (float)(row))) * glm::scale(glm::mat4(1.0f), glm::vec3(UNITARY_SCALE));
-						}
-						else
-						{
-							mazeUbo.mMat[row][col][h] = glm::translate(glm::mat4(1.0f), glm::vec3(UNITARY_SCALE * (float)(col), -20 - 2 * (float)h, UNITARY_SCALE * (float)(row))) * glm::scale(glm::mat4(1.0f), glm::vec3(0.1f));
-						}
-						mazeUbo.nMat[row][col][h] = glm::inverse(glm::transpose(mazeUbo.mMat[row][col][h]));
-					}
-					mazeUbo.mvpMat[row][col][h] = ViewPrj * mazeUbo.mMat[row][col][h];
-				}
+				int chunk = mazeChunksGrid[(cell.r / MAZE_MESH_CHUNK_SIZE) * chunksColumns + cell.c / MAZE_MESH_CHUNK_SIZE];
+				if (chunk >= 0)
+					drawMazeChunk(chunk);
+			}
+		}
+		else
+		{
+			// Out of the maze the walls hide nothing: only the view frustum and the distance in sight count
+			for (size_t i = 0; i < mazeChunks.size(); i++)
+			{
+				glm::vec3 closestPoint = glm::clamp(player.getPosition(), mazeChunks[i].boundsMin, mazeChunks[i].boundsMax);
+				if (glm::distance(closestPoint, player.getPosition()) <= viewRange)
+					drawMazeChunk(i);
 			}
 		}
+		for (uint32_t chunk : drawnMazeChunks)
+			mazeChunkDrawn[chunk] = false;
+		drawnMazeChunks.clear();
 
 		// Boxes blinn parameters
 		if (uniformBuffersInit == false)
@@ -827,8 +935,7 @@ protected:
 		DSPavement.map(currentImage, &pavUbo, 0);
 		DSPavement.map(currentImage, &pavparubo, 3);
 
-		DSBox.map(currentImage, &mazeUbo, 0);
-		DSBox.map(currentImage, &boxparubo, 4);
+		DSBox.map(currentImage, &boxparubo, 3);
 
 		DSPlatform.map(currentImage, &platUbo, 0);
 
@@ -845,9 +952,8 @@ protected:
 	}
 };
 
-int main()
+int main(int argc, char *argv[])
 {
-	srand(8);
 	std::cout << "Starting with maze size " << MAZE_SIZE << std::endl;
 	
 	//Setup Texts To Be Displayed
@@ -863,9 +969,10 @@ int main()
 	demoText.push_back({2, {"You found all the keys", "Search for the teleportation platform and step on it", "", ""}, 0, 0});
 	demoText.push_back({2, {"Congratulations, YOU ESCAPED", "PRESS ESC TO QUIT", "", ""}, 0, 0});
 
-	Project app;
 	try
 	{
+		// An optional maze file can be given as the first argument
+		Project app(argc > 1 ? argv[1] : nullptr);
 		app.run();
 	}
 	catch (const std::exception &e)
@@ -1,6 +1,6 @@
 #version 450
-#define KEYS_NUMBER 3
-#define WALL_LIGHTS_NUMBER 6
+#extension GL_GOOGLE_include_directive : require
+#include "../modules/MazeConstants.h"
 #extension GL_ARB_separate_shader_objects : enable
 
 layout(location = 0) in vec3 fragPos;
@@ -34,6 +34,18 @@ layout(set = 1, binding = 2) uniform sampler2D texSpec;
 layout(set = 1, binding = 3) uniform sampler2D texAMB;
 
 
+// Islands of the cube texture atlas (origin, size) for each face direction (see MazeConstants.h).
+// The UVs of the maze mesh count the blocks along a face: the fractional part is the position in the island
+const vec2 atlasIslandSize = vec2(ATLAS_ISLAND_SIDE, ATLAS_ISLAND_SIDE);
+vec2 atlas_island(vec3 N) {
+	if(abs(N.y) > 0.5) {
+		return N.y > 0.0 ? vec2(ATLAS_ISLAND_TOP) : vec2(ATLAS_ISLAND_BOTTOM);
+	} else if(abs(N.x) > 0.5) {
+		return N.x > 0.0 ? vec2(ATLAS_ISLAND_EAST) : vec2(ATLAS_ISLAND_WEST);
+	}
+	return N.z > 0.0 ? vec2(ATLAS_ISLAND_SOUTH) : vec2(ATLAS_ISLAND_NORTH);
+}
+
 vec3 point_light_dir(vec3 lightPos) {
 	// Point light - direction vector
 	return normalize(lightPos-fragPos);
@@ -59,7 +71,11 @@ vec3 point_light_color(vec3 lightPos, vec4 lightColor, float decayFactor) {
 void main() {
     vec3 Norm = normalize(fragNorm);
 	vec3 EyeDir = normalize(gubo.eyePos - fragPos);
-    vec3 AmbientColor = texture(texAMB, fragUV).rgb;
+	// The gradients of the continuous UVs avoid the jump of mip level where the tiles wrap
+	vec2 UV = atlas_island(Norm) + fract(fragUV) * atlasIslandSize;
+	vec2 UVdx = dFdx(fragUV) * atlasIslandSize;
+	vec2 UVdy = dFdy(fragUV) * atlasIslandSize;
+    vec3 AmbientColor = textureGrad(texAMB, UV, UVdx, UVdy).rgb;
 
     const vec3 cxp = vec3(0.5,0.5,0.3) * 0.25;
 	const vec3 cxn = vec3(0.5,0.5,0.3) * 0.25;
@@ -71,8 +87,8 @@ void main() {
 	vec3 Ambient =((Norm.x > 0 ? cxp : cxn) * (Norm.x * Norm.x) +
 				   (Norm.y > 0 ? cyp : cyn) * (Norm.y * Norm.y) +
 				   (Norm.z > 0 ? czp : czn) * (Norm.z * Norm.z)) * AmbientColor * boxparUBO.ambientFactor ;
-	vec3 DiffuseOriginalColor = texture(texDiff, fragUV).rgb;
-	vec3 SpecularOriginalColor = texture(texSpec, fragUV).rgb;
+	vec3 DiffuseOriginalColor = textureGrad(texDiff, UV, UVdx, UVdy).rgb;
+	vec3 SpecularOriginalColor = textureGrad(texSpec, UV, UVdx, UVdy).rgb;
 	// Hand Light
 
 	vec3 handLightColorComputed = point_light_color(gubo.handLightPos, gubo.handLightColor, gubo.handLightDecayFactor);
@@ -1,6 +1,6 @@
 #version 450
-#define MAZE_SIZE 17 // Make this the same as MazeGenerator.hpp
-#define MAZE_HEIGHT 2 // Make this the same as MazeGenerator.hpp
+#extension GL_GOOGLE_include_directive : require
+#include "../modules/MazeConstants.h"
 #extension GL_ARB_separate_shader_objects : enable
 
 // The attributes associated with each vertex.
@@ -16,28 +16,39 @@ layout(location = 0) out vec3 fragPos;
 layout(location = 1) out vec3 fragNorm;
 layout(location = 2) out vec2 fragUV;
 
-// Here the Uniform buffers are defined. In this case, the Transform matrices (Set 1, binding 0)
-// are used. Note that the definition must match the one used in the CPP code
-layout(set = 1, binding = 0) uniform MazeUniformBufferObject {
-	mat4 mvpMat[MAZE_SIZE][MAZE_SIZE][MAZE_HEIGHT];
-	mat4 mMat[MAZE_SIZE][MAZE_SIZE][MAZE_HEIGHT];
-	mat4 nMat[MAZE_SIZE][MAZE_SIZE][MAZE_HEIGHT];
-} mazeUbo;
+// Here the Uniform buffers are defined. In this case, only the view-projection matrix of the Global Uniforms
+// (Set 0, binding 0) is used: the maze mesh is already in World Space.
+// Note that the definition must match the one used in the CPP code
+layout(set = 0, binding = 0) uniform GlobalUniformBufferObject {
+	vec3 eyePos;
+	vec3 handLightPos;
+	vec4 handLightColor;
+	float handLightDecayFactor;
+	vec4 wallLampPos[WALL_LIGHTS_NUMBER];
+	vec4 wallLampColor;
+	float wallLampDecayFactor;
+
+	vec3 cupLightPos;
+	vec4 cupLightColor;
+	vec3 cupLightDir;
+	float cupLightDecayFactor;
+	float cupCIN;
+	float cupCOUT;
+
+	mat4 viewPrj;
+} gubo;
+
 
 
 
 // Here the shader simply computes clipping coordinates, and passes to the Fragment Shader
-// the position of the point in World Space, the transformed direction of the normal vector,
+// the position of the point in World Space, the normal vector,
 // and the untouched (but interpolated) UV coordinates
 void main() {
-	int i = gl_InstanceIndex;
-	int r = gl_InstanceIndex / (MAZE_SIZE*2);
-	int c = (gl_InstanceIndex % (MAZE_SIZE*2)) /2;
-	int h = gl_InstanceIndex % (MAZE_HEIGHT);
 	// Clipping coordinates must be returned in global variable gl_Posision
-	gl_Position = mazeUbo.mvpMat[r][c][h] * vec4(inPosition, 1.0);
+	gl_Position = gubo.viewPrj * vec4(inPosition, 1.0);
 	// Here the value of the out variables passed to the Fragment shader are computed
-	fragPos = (mazeUbo.mMat[r][c][h] * vec4(inPosition, 1.0)).xyz;
-	fragNorm = (mazeUbo.nMat[r][c][h] * vec4(inNorm, 0.0)).xyz;
+	fragPos = inPosition;
+	fragNorm = inNorm;
 	fragUV = inUV;
 }
\ No newline at end of file
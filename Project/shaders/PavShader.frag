@@ -1,6 +1,6 @@
 #version 450
-#define KEYS_NUMBER 3
-#define WALL_LIGHTS_NUMBER 6
+#extension GL_GOOGLE_include_directive : require
+#include "../modules/MazeConstants.h"
 #extension GL_ARB_separate_shader_objects : enable
 
 // this defines the variable received from the Vertex Shader
@@ -0,0 +1,349 @@
+// Tests of the modules that don't need a GPU nor a window: make test (from the Project directory)
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include "../modules/MazeGenerator.hpp"
+#include "../modules/MazeBatchGenerator.hpp"
+#include "../modules/MazeMesher.hpp"
+#include "../modules/BlockCompressor.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition)                                                                  \
+  do                                                                                      \
+  {                                                                                       \
+    if (!(condition))                                                                     \
+    {                                                                                     \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << "\n"; \
+      failures++;                                                                         \
+    }                                                                                     \
+  } while (false)
+
+template <typename F>
+bool throwsRuntimeError(F function)
+{
+  try
+  {
+    function();
+  }
+  catch (const std::runtime_error &)
+  {
+    return true;
+  }
+  return false;
+}
+
+bool sameMaze(const Maze &a, const Maze &b)
+{
+  MazeView viewA = a.getMazeView(), viewB = b.getMazeView();
+  if (viewA.getWidth() != viewB.getWidth() || viewA.getHeight() != viewB.getHeight())
+    return false;
+  for (int r = 0; r < viewA.getHeight(); r++)
+    for (int c = 0; c < viewA.getWidth(); c++)
+      if (viewA.get(r, c) != viewB.get(r, c))
+        return false;
+  if (viewA.getLights().size() != viewB.getLights().size() || viewA.getKeys().size() != viewB.getKeys().size())
+    return false;
+  for (size_t i = 0; i < viewA.getLights().size(); i++)
+  {
+    const Light &lightA = viewA.getLights()[i], &lightB = viewB.getLights()[i];
+    if (lightA.point.r != lightB.point.r || lightA.point.c != lightB.point.c || lightA.direction != lightB.direction)
+      return false;
+  }
+  for (size_t i = 0; i < viewA.getKeys().size(); i++)
+  {
+    const Key &keyA = viewA.getKeys()[i], &keyB = viewB.getKeys()[i];
+    if (keyA.point.r != keyB.point.r || keyA.point.c != keyB.point.c || keyA.isTaken != keyB.isTaken)
+      return false;
+  }
+  return a.getStartPoint().r == b.getStartPoint().r && a.getStartPoint().c == b.getStartPoint().c &&
+         a.getEndPoint().r == b.getEndPoint().r && a.getEndPoint().c == b.getEndPoint().c;
+}
+
+// Maze file (user-009): what writeMaze writes readMaze reads back, damaged records are rejected
+void testMazeFileRoundTrip()
+{
+  Maze maze(42, 21, 17);
+  maze.setVerbose(false);
+  maze.generateMaze();
+  std::vector<uint8_t> buffer;
+  maze.writeMaze(buffer);
+  maze.writeMaze(buffer); // A library of two mazes
+
+  Maze read(0);
+  size_t offset = read.readMaze(buffer.data(), buffer.size());
+  CHECK(offset == buffer.size() / 2);
+  CHECK(sameMaze(maze, read));
+  CHECK(read.getSeed() == 42);
+  CHECK(read.readMaze(buffer.data() + offset, buffer.size() - offset) == offset);
+  CHECK(sameMaze(maze, read));
+
+  // Truncated
+  size_t recordSize = buffer.size() / 2;
+  CHECK(throwsRuntimeError([&] { read.readMaze(buffer.data(), recordSize - 1); }));
+  CHECK(throwsRuntimeError([&] { read.readMaze(buffer.data(), 10); }));
+
+  // Header: magic, size too small or not an int, start out of the grid
+  auto corrupted = [&](size_t at, const void *value, size_t size)
+  {
+    std::vector<uint8_t> damaged(buffer.begin(), buffer.begin() + recordSize);
+    memcpy(damaged.data() + at, value, size);
+    return throwsRuntimeError([&] { Maze(0).readMaze(damaged.data(), damaged.size()); });
+  };
+  uint32_t tooSmall = MIN_MAZE_SIZE - 1, tooLarge = 0x80000000u;
+  int32_t outside = 17, negative = -1;
+  CHECK(corrupted(offsetof(MazeFileHeader, magic), "MAZX", 4));
+  CHECK(corrupted(offsetof(MazeFileHeader, width), &tooSmall, 4));
+  CHECK(corrupted(offsetof(MazeFileHeader, height), &tooLarge, 4));
+  CHECK(corrupted(offsetof(MazeFileHeader, startR), &outside, 4));
+
+  // Lights and keys records: row, column, direction (lights) or taken (keys)
+  size_t records = recordSize - (maze.getMazeLights().size() + maze.getMazeKeys().size()) * 3 * sizeof(int32_t);
+  size_t keys = records + maze.getMazeLights().size() * 3 * sizeof(int32_t);
+  int32_t badDirection = 3;
+  CHECK(corrupted(records, &outside, 4));
+  CHECK(corrupted(records + 4, &negative, 4));
+  CHECK(corrupted(records + 8, &badDirection, 4));
+  CHECK(corrupted(keys, &negative, 4));
+  CHECK(corrupted(keys + 4, &tooLarge, 4));
+  CHECK(!corrupted(keys + 8, &outside, 4)); // Any taken value is fine
+}
+
+// Generation (user-004): a seed always gives the same maze, in both modes and on any thread
+void testSameSeedSameMaze()
+{
+  for (GenerationMode mode : {GenerationMode::REJECTION, GenerationMode::CONSTRAINED})
+  {
+    std::vector<uint64_t> seeds;
+    std::vector<Maze> mazes;
+    for (uint64_t seed = 1; seed <= 16; seed++)
+    {
+      seeds.push_back(seed);
+      mazes.emplace_back(seed, 25, 19);
+      mazes.back().setVerbose(false);
+      mazes.back().setGenerationMode(mode);
+      mazes.back().generateMaze();
+    }
+    for (size_t i = 0; i < mazes.size(); i++)
+    {
+      Maze again(seeds[i], 25, 19);
+      again.setVerbose(false);
+      again.setGenerationMode(mode);
+      again.generateMaze();
+      CHECK(sameMaze(mazes[i], again));
+    }
+    CHECK(!sameMaze(mazes[0], mazes[1]));
+
+    ThreadPool pool(4);
+    MazeBatchGenerator generator(pool);
+    MazeBatchParameters parameters;
+    parameters.width = 25;
+    parameters.height = 19;
+    parameters.mode = mode;
+    std::vector<Maze> batch = generator.generate(seeds, parameters);
+    for (size_t i = 0; i < mazes.size(); i++)
+      CHECK(sameMaze(mazes[i], batch[i]));
+  }
+}
+
+// Maze mesh (user-014): the faces of a known maze, and the area of the merged faces of a generated one
+void testMazeMesherFaces()
+{
+  // A ring of 8 walls around a path cell
+  MazeGrid grid(3, 3);
+  grid.set(1, 1, MazeWay::PATH);
+  std::vector<Light> lights;
+  std::vector<Key> keys;
+  MazePoint start = {1, 1}, end = {1, 1};
+  MazeView ring(grid, lights, keys, start, end);
+
+  // Tops: the first row, the two columns below it, the middle of the last row. Sides: the 4 outer ones
+  // and the 4 around the path cell
+  MazeMesh mesh = MazeMesher(1.0f, 2).build(ring);
+  CHECK(mesh.indices.size() == 12 * 6);
+  CHECK(mesh.vertices.size() == 12 * 4);
+  CHECK(mesh.chunks.size() == 1);
+  CHECK(mesh.wallBlocks == 16);
+
+  // Chunks of 2x2 cells: no face crosses two chunks, so 5 tops and 12 sides
+  mesh = MazeMesher(1.0f, 2, 2).build(ring);
+  CHECK(mesh.indices.size() == 17 * 6);
+  CHECK(mesh.chunks.size() == 4);
+  uint32_t chunkIndices = 0;
+  for (const MazeMeshChunk &chunk : mesh.chunks)
+    chunkIndices += chunk.indexCount;
+  CHECK(chunkIndices == mesh.indices.size());
+
+  // Merged or not, the tops cover the wall cells and the sides the faces between a wall and a path or the outside
+  Maze maze(7, 33, 29);
+  maze.setVerbose(false);
+  maze.generateMaze();
+  MazeView view = maze.getMazeView();
+  float wallCells = 0, exposedSides = 0;
+  for (int r = 0; r < view.getHeight(); r++)
+    for (int c = 0; c < view.getWidth(); c++)
+      if (view.isWall(r, c))
+      {
+        wallCells++;
+        for (MazePoint next : {MazePoint{r - 1, c}, MazePoint{r + 1, c}, MazePoint{r, c - 1}, MazePoint{r, c + 1}})
+          if (next.r < 0 || next.r >= view.getHeight() || next.c < 0 || next.c >= view.getWidth() || !view.isWall(next.r, next.c))
+            exposedSides++;
+      }
+  mesh = MazeMesher(2.0f, 3).build(view);
+  float topsArea = 0, sidesArea = 0;
+  for (size_t i = 0; i < mesh.indices.size(); i += 6)
+  {
+    // Two triangles of a quad: the area is the length of the cross product of two of its sides
+    const glm::vec3 &a = mesh.vertices[mesh.indices[i]].pos, &b = mesh.vertices[mesh.indices[i + 1]].pos, &c = mesh.vertices[mesh.indices[i + 2]].pos;
+    float area = glm::length(glm::cross(b - a, c - b));
+    if (mesh.vertices[mesh.indices[i]].norm.y > 0.5f)
+      topsArea += area;
+    else
+      sidesArea += area;
+  }
+  CHECK(std::fabs(topsArea - wallCells * 2.0f * 2.0f) < 1e-2f);
+  CHECK(std::fabs(sidesArea - exposedSides * 2.0f * 6.0f) < 1e-2f);
+  CHECK(mesh.indices.size() / 6 < wallCells + exposedSides); // Some faces were merged
+}
+
+// Block compression (user-024): decoders written from the BC1 and BC7 (mode 6) specifications
+void decodeBC1(const uint8_t in[8], uint8_t block[64])
+{
+  uint16_t colors[2] = {(uint16_t)(in[0] | in[1] << 8), (uint16_t)(in[2] | in[3] << 8)};
+  int palette[4][3];
+  for (int e = 0; e < 2; e++)
+  {
+    int r = colors[e] >> 11, g = colors[e] >> 5 & 63, b = colors[e] & 31;
+    palette[e][0] = r << 3 | r >> 2;
+    palette[e][1] = g << 2 | g >> 4;
+    palette[e][2] = b << 3 | b >> 2;
+  }
+  bool fourColors = colors[0] > colors[1];
+  for (int c = 0; c < 3; c++)
+  {
+    palette[2][c] = fourColors ? (2 * palette[0][c] + palette[1][c]) / 3 : (palette[0][c] + palette[1][c]) / 2;
+    palette[3][c] = fourColors ? (palette[0][c] + 2 * palette[1][c]) / 3 : 0;
+  }
+  uint32_t bits = in[4] | in[5] << 8 | in[6] << 16 | (uint32_t)in[7] << 24;
+  for (int i = 0; i < 16; i++)
+  {
+    int index = bits >> (2 * i) & 3;
+    for (int c = 0; c < 3; c++)
+      block[4 * i + c] = (uint8_t)palette[index][c];
+    block[4 * i + 3] = fourColors || index != 3 ? 255 : 0;
+  }
+}
+
+void decodeBC7Mode6(const uint8_t in[16], uint8_t block[64])
+{
+  int bit = 0;
+  auto bits = [&](int count)
+  {
+    int value = 0;
+    for (int i = 0; i < count; i++, bit++)
+      value |= (in[bit / 8] >> (bit % 8) & 1) << i;
+    return value;
+  };
+  CHECK(bits(7) == 1 << 6);
+  int endpoints[2][4];
+  for (int c = 0; c < 4; c++)
+    for (int e = 0; e < 2; e++)
+      endpoints[e][c] = bits(7) << 1;
+  for (int e = 0; e < 2; e++)
+  {
+    int p = bits(1);
+    for (int c = 0; c < 4; c++)
+      endpoints[e][c] |= p;
+  }
+  static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+  for (int i = 0; i < 16; i++)
+  {
+    int weight = weights[bits(i == 0 ? 3 : 4)];
+    for (int c = 0; c < 4; c++)
+      block[4 * i + c] = (uint8_t)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+  }
+}
+
+double blockRmse(const std::vector<std::vector<uint8_t>> &blocks, bool bc7)
+{
+  // Over the RGB channels (and the alpha for BC7) of all the blocks
+  double error = 0;
+  int channels = bc7 ? 4 : 3;
+  for (const std::vector<uint8_t> &block : blocks)
+  {
+    uint8_t encoded[16], decoded[64];
+    if (bc7)
+    {
+      BlockCompressor::encodeBC7(block.data(), encoded);
+      decodeBC7Mode6(encoded, decoded);
+    }
+    else
+    {
+      BlockCompressor::encodeBC1(block.data(), encoded);
+      decodeBC1(encoded, decoded);
+    }
+    for (int i = 0; i < 16; i++)
+      for (int c = 0; c < channels; c++)
+        error += (block[4 * i + c] - decoded[4 * i + c]) * (block[4 * i + c] - decoded[4 * i + c]);
+  }
+  return std::sqrt(error / (blocks.size() * 16 * channels));
+}
+
+void testBlockCompressorError()
+{
+  // Flat, gradient and noisy blocks (a random color, each texel off by up to 24 per channel)
+  MazeRandom random(11);
+  std::vector<std::vector<uint8_t>> flat, gradients, noisy;
+  for (int b = 0; b < 200; b++)
+  {
+    std::vector<uint8_t> block(64);
+    int base[4], step[4];
+    for (int c = 0; c < 4; c++)
+    {
+      base[c] = random.nextInt(256);
+      step[c] = random.nextInt(9) - 4;
+    }
+    for (int i = 0; i < 16; i++)
+      for (int c = 0; c < 4; c++)
+        block[4 * i + c] = (uint8_t)(c == 3 ? 255 : base[c]);
+    flat.push_back(block);
+    for (int i = 0; i < 16; i++)
+      for (int c = 0; c < 4; c++)
+        block[4 * i + c] = (uint8_t)std::min(std::max(base[c] + step[c] * (i % 4 + i / 4), 0), 255);
+    gradients.push_back(block);
+    for (int i = 0; i < 16; i++)
+      for (int c = 0; c < 4; c++)
+        block[4 * i + c] = (uint8_t)std::min(std::max(base[c] + random.nextInt(49) - 24, 0), 255);
+    noisy.push_back(block);
+  }
+  double flatBC1 = blockRmse(flat, false), flatBC7 = blockRmse(flat, true);
+  double gradientsBC1 = blockRmse(gradients, false), gradientsBC7 = blockRmse(gradients, true);
+  double noisyBC1 = blockRmse(noisy, false), noisyBC7 = blockRmse(noisy, true);
+  std::cout << "        RMSE flat " << flatBC1 << " / " << flatBC7 << ", gradients " << gradientsBC1 << " / " << gradientsBC7
+            << ", noisy " << noisyBC1 << " / " << noisyBC7 << " (BC1 / BC7)\n";
+  CHECK(flatBC1 < 3.0);
+  CHECK(flatBC7 < 1.0);
+  CHECK(gradientsBC1 < 4.0);
+  CHECK(gradientsBC7 < 1.5);
+  CHECK(noisyBC1 < 14.0);
+  CHECK(noisyBC7 < 12.0);
+}
+
+int main()
+{
+  std::vector<std::pair<std::string, std::function<void()>>> tests = {
+      {"maze file round trip", testMazeFileRoundTrip},
+      {"same seed same maze", testSameSeedSameMaze},
+      {"maze mesher faces", testMazeMesherFaces},
+      {"block compressor error", testBlockCompressorError},
+  };
+  for (const auto &test : tests)
+  {
+    int before = failures;
+    test.second();
+    std::cout << (failures == before ? "ok     " : "FAILED ") << test.first << "\n";
+  }
+  std::cout << (failures == 0 ? "All the tests passed" : std::to_string(failures) + " checks failed") << "\n";
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+// Offline baker of the textures: converts a JPG or PNG image, with its whole mip chain, to a KTX2 file
+// that Texture::init loads in place of the image (see Ktx2.hpp and BlockCompressor.hpp), as long as the
+// image does not change: the file keeps the content hash of the image.
+//
+// usage: TextureBaker [-f bc1|bc7|rgba8] [-linear] source output.ktx2
+//   bc7 (default): 8 bits per texel, RGBA, for the color maps
+//   bc1:           4 bits per texel, RGB only, for the specular and ambient maps
+//   rgba8:         32 bits per texel, not compressed (for the font atlas)
+//   -linear:       the image does not hold sRGB colors (normal maps, masks...)
+//
+// The mips are filtered with a Kaiser windowed sinc (much sharper than the 2x2 box of vkCmdBlitImage,
+// without its aliasing) on linear, alpha premultiplied colors, each level from the previous one.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include "../modules/Ktx2.hpp"
+#include "../modules/BlockCompressor.hpp"
+#include "../modules/ThreadPool.hpp"
+#include "../modules/MeshCache.hpp"
+#define MIP_FILTER_RADIUS 3.0f // In texels of the smaller level
+#define MIP_FILTER_KAISER_ALPHA 4.0f
+
+// Linear, alpha premultiplied colors
+struct MipImage
+{
+  int width;
+  int height;
+  std::vector<float> rgba;
+};
+
+struct FilterTap
+{
+  int index;
+  float weight;
+};
+
+float srgbToLinear(float value)
+{
+  return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float value)
+{
+  return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+MipImage toLinear(const std::vector<uint8_t> &rgba, int width, int height, bool srgb)
+{
+  float decode[256];
+  for (int i = 0; i < 256; i++)
+    decode[i] = srgb ? srgbToLinear(i / 255.0f) : i / 255.0f;
+  MipImage image{width, height, std::vector<float>(rgba.size())};
+  for (size_t i = 0; i < rgba.size(); i += 4)
+  {
+    float alpha = rgba[i + 3] / 255.0f;
+    for (int c = 0; c < 3; c++)
+      image.rgba[i + c] = decode[rgba[i + c]] * alpha;
+    image.rgba[i + 3] = alpha;
+  }
+  return image;
+}
+
+std::vector<uint8_t> toRgba8(const MipImage &image, bool srgb)
+{
+  std::vector<uint8_t> rgba(image.rgba.size());
+  for (size_t i = 0; i < rgba.size(); i += 4)
+  {
+    // The filter rings a little around the sharp edges: the values are clamped
+    float alpha = std::min(std::max(image.rgba[i + 3], 0.0f), 1.0f);
+    for (int c = 0; c < 3; c++)
+    {
+      float value = alpha > 0 ? std::min(std::max(image.rgba[i + c] / alpha, 0.0f), 1.0f) : 0.0f;
+      rgba[i + c] = (uint8_t)std::lround(255 * (srgb ? linearToSrgb(value) : value));
+    }
+    rgba[i + 3] = (uint8_t)std::lround(255 * alpha);
+  }
+  return rgba;
+}
+
+float besselI0(float x)
+{
+  float sum = 1.0f, term = 1.0f;
+  for (int k = 1; k < 32; k++)
+  {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+std::vector<std::vector<FilterTap>> filterTaps(int sourceSize, int size)
+{
+  // Source texels around each texel of the smaller level, with the textures repeating as with the samplers
+  float scale = (float)sourceSize / size;
+  std::vector<std::vector<FilterTap>> taps(size);
+  for (int i = 0; i < size; i++)
+  {
+    float center = (i + 0.5f) * scale - 0.5f, total = 0;
+    int first = (int)std::ceil(center - MIP_FILTER_RADIUS * scale), last = (int)std::floor(center + MIP_FILTER_RADIUS * scale);
+    for (int s = first; s <= last; s++)
+    {
+      float x = (s - center) / scale, ratio = x / MIP_FILTER_RADIUS;
+      float sinc = x == 0 ? 1.0f : std::sin((float)M_PI * x) / ((float)M_PI * x);
+      float window = besselI0(MIP_FILTER_KAISER_ALPHA * std::sqrt(std::max(1.0f - ratio * ratio, 0.0f))) / besselI0(MIP_FILTER_KAISER_ALPHA);
+      if (sinc * window == 0)
+        continue;
+      taps[i].push_back({((s % sourceSize) + sourceSize) % sourceSize, sinc * window});
+      total += sinc * window;
+    }
+    for (FilterTap &tap : taps[i])
+      tap.weight /= total;
+  }
+  return taps;
+}
+
+MipImage downsample(ThreadPool &threads, const MipImage &source)
+{
+  // Separable filter: the rows, then the columns
+  MipImage rows{std::max(source.width / 2, 1), source.height, {}};
+  rows.rgba.resize((size_t)rows.width * rows.height * 4);
+  std::vector<std::vector<FilterTap>> taps = filterTaps(source.width, rows.width);
+  threads.parallelFor(rows.height, [&](size_t y) {
+    for (int x = 0; x < rows.width; x++)
+      for (const FilterTap &tap : taps[x])
+        for (int c = 0; c < 4; c++)
+          rows.rgba[4 * (y * rows.width + x) + c] += tap.weight * source.rgba[4 * (y * source.width + tap.index) + c];
+  });
+
+  MipImage mip{rows.width, std::max(source.height / 2, 1), {}};
+  mip.rgba.resize((size_t)mip.width * mip.height * 4);
+  taps = filterTaps(rows.height, mip.height);
+  threads.parallelFor(mip.height, [&](size_t y) {
+    for (const FilterTap &tap : taps[y])
+      for (int x = 0; x < 4 * mip.width; x++)
+        mip.rgba[4 * y * mip.width + x] += tap.weight * rows.rgba[4 * (size_t)tap.index * rows.width + x];
+  });
+  return mip;
+}
+
+std::vector<uint8_t> compress(ThreadPool &threads, const std::vector<uint8_t> &rgba, int width, int height, uint32_t format)
+{
+  if (!Ktx2File::isCompressed(format))
+    return rgba;
+  int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+  uint32_t blockBytes = Ktx2File::blockBytes(format);
+  std::vector<uint8_t> blocks((size_t)blocksX * blocksY * blockBytes);
+  threads.parallelFor(blocksY, [&](size_t blockY) {
+    uint8_t block[64];
+    for (int blockX = 0; blockX < blocksX; blockX++)
+    {
+      BlockCompressor::loadBlock(rgba.data(), width, height, blockX, (int)blockY, block);
+      uint8_t *out = &blocks[(blockY * blocksX + blockX) * blockBytes];
+      if (blockBytes == 8)
+        BlockCompressor::encodeBC1(block, out);
+      else
+        BlockCompressor::encodeBC7(block, out);
+    }
+  });
+  return blocks;
+}
+
+int main(int argc, char *argv[])
+{
+  std::string formatName = "bc7";
+  bool srgb = true;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "-f" && i + 1 < argc)
+      formatName = argv[++i];
+    else if (arg == "-linear")
+      srgb = false;
+    else
+      paths.push_back(arg);
+  }
+  uint32_t format;
+  if (formatName == "bc1")
+    format = srgb ? KTX2_FORMAT_BC1_RGB_SRGB : KTX2_FORMAT_BC1_RGB_UNORM;
+  else if (formatName == "bc7")
+    format = srgb ? KTX2_FORMAT_BC7_SRGB : KTX2_FORMAT_BC7_UNORM;
+  else if (formatName == "rgba8")
+    format = srgb ? KTX2_FORMAT_R8G8B8A8_SRGB : KTX2_FORMAT_R8G8B8A8_UNORM;
+  else
+  {
+    std::cerr << "Unknown format " << formatName << "\n";
+    return 1;
+  }
+  if (paths.size() != 2)
+  {
+    std::cerr << "usage: TextureBaker [-f bc1|bc7|rgba8] [-linear] source output.ktx2\n";
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  int width, height, channels;
+  stbi_uc *pixels = stbi_load(paths[0].c_str(), &width, &height, &channels, STBI_rgb_alpha);
+  if (!pixels)
+  {
+    std::cerr << "Can't load " << paths[0] << "\n";
+    return 1;
+  }
+  std::vector<uint8_t> rgba(pixels, pixels + (size_t)width * height * 4);
+  stbi_image_free(pixels);
+
+  // The first level keeps the exact texels of the image, the others are filtered in floating point
+  ThreadPool threads;
+  std::vector<std::vector<uint8_t>> data;
+  std::vector<Ktx2Level> levels;
+  MipImage mip = toLinear(rgba, width, height, srgb);
+  while (true)
+  {
+    data.push_back(compress(threads, rgba, mip.width, mip.height, format));
+    levels.push_back({(uint32_t)mip.width, (uint32_t)mip.height, nullptr, data.back().size()});
+    if (mip.width == 1 && mip.height == 1)
+      break;
+    mip = downsample(threads, mip);
+    rgba = toRgba8(mip, srgb);
+  }
+  for (size_t i = 0; i < levels.size(); i++)
+    levels[i].data = data[i].data();
+
+  if (!Ktx2File::write(paths[1], format, levels, "TextureBaker", MeshCache::hashFile(paths[0])))
+  {
+    std::cerr << "Can't write " << paths[1] << "\n";
+    return 1;
+  }
+  size_t bytes = 0;
+  for (const Ktx2Level &level : levels)
+    bytes += level.size;
+  float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+  std::cout << paths[0] << " -> " << paths[1] << ": " << levels[0].width << "x" << levels[0].height << ", "
+            << levels.size() << " levels, " << bytes / 1024 << " KiB in " << seconds << " s\n";
+  return 0;
+}